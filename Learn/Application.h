@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <chrono>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -8,28 +9,42 @@
 #include "Window.h"
 #include "ValidationDebugger.h"
 #include "LogicalDevice.h"
+#include "MemoryAllocator.h"
 #include "SwapChain.h"
 #include "RenderPass.h"
 #include "DescriptorPool.h"
 #include "DescriptorSets.h"
+#include "PipelineCache.h"
 #include "Pipeline.h"
 #include "CommandPool.h"
+#include "UploadManager.h"
 #include "Resources.h"
 #include "Framebuffers.h"
 #include "Texture.h"
 #include "AssimpModel.h"
+#include "LodSelector.h"
+#include "MeshletCuller.h"
 #include "UniformBuffers.h"
+#include "ObjectBuffer.h"
 #include "DrawCommands.h"
+#include "RenderQueue.h"
+#include "ThreadPool.h"
+#include "DeletionQueue.h"
 #include "Fences.h"
 #include "Semaphores.h"
+#include "Benchmark.h"
 
 const int MAX_IN_FLIGHT = 2;
+const float FAR_PLANE = 50.0f;
+// Imports run on their own workers, so a long import never delays recording or pipeline compiles.
+const uint32_t LOADER_THREAD_COUNT = 2;
 
 class Application {
 public:
 	~Application() {};
-	Application();
+	Application(BenchmarkSettings benchmarkSettings = BenchmarkSettings());
 	void run();
+	bool isHeadless() { return benchmarkSettings.enable; }
 
 	bool windowIsResized = false;
 
@@ -37,13 +52,17 @@ private:
 	void init();
 	void cleanup();
 
+	void runBenchmark();
 	void drawFrame();
-	void acquireNextSwapChainImageIndex(uint32_t& imageIndex);
+	bool acquireNextSwapChainImageIndex(uint32_t& imageIndex);
 	void waitForSwapChainImageReady(uint32_t swapChainIndex);
-	void updateUniformBuffer(uint32_t swapChainIndex);
-	void updateDynamicUniformBuffer(uint32_t swapChainIndex);
+	glm::mat4 getProjectionMatrix();
+	void updateUniformBuffer();
+	void updateObjectBuffer();
+	void updateDrawItems();
+	void updateInstanceBuffer();
 
-	void setupSubmitInfo(VkSubmitInfo& submitInfo, uint32_t swapChainIndex, 
+	void setupSubmitInfo(VkSubmitInfo& submitInfo,
 		VkSemaphore* waitSemaphores, VkSemaphore* signalSemaphores, VkPipelineStageFlags* waitStages);
 	void submitDrawCommands(VkSubmitInfo& submitInfo);
 	void presentImage(uint32_t* swapChainIndex, VkSemaphore* waitSemaphore);
@@ -51,6 +70,9 @@ private:
 	void windowResize();
 	void cleanupSwapChainRelated();
 	void recreateSwapChainRelated();
+	void retireSwapChainRelated(SwapChain* oldSwapChain);
+	void recreateRenderPass();
+	void replacePipeline(bool depthPrepass);
 
 	Camera* camera;
 	UserInputManager* inputManager;
@@ -60,91 +82,143 @@ private:
 	Instance* instance;
 	PhysicalDevice* physicalDevice;
 	LogicalDevice* device;
+	MemoryAllocator* allocator;
 	SwapChain* swapChain;
 	CommandPool* commandPool;
+	UploadManager* uploadManager;
 	DescriptorPool* descriptorPool;
 	// Texture* texture;
 	VertexLayout* vertexLayout;
+	GeometryPool* geometryPool;
 	AssimpModel* model;
+	LodSelector* lodSelector;
+	MeshletCuller* meshletCuller;
 	ColorResource* colorResource;
 	DepthResource* depthResouce;
 	DescriptorSetLayout* descriptorSetLayout;
 	RenderPass* renderPass;
 	Framebuffers* framebuffers;
 	UniformBuffers* uniformBuffers;
+	ObjectBuffer* objectBuffer;
 	DescriptorSets* descriptorSets;
+	PipelineCache* pipelineCache;
 	Pipeline* pipeline;
 	DrawCommands* drawCommands;
+	ThreadPool* threadPool;
+	ThreadPool* loaderPool;
+	DeletionQueue* deletionQueue;
+	RenderQueue* renderQueue;
+	// Draws of the single object being culled, before they are queued
+	std::vector<DrawItem> culledItems;
+	std::vector<glm::mat4> objectMatrices;
+	// Objects of each model, level of detail and pipeline, rebuilt every frame
+	std::vector<std::vector<uint32_t>> instanceGroups;
+	std::vector<uint32_t> instances;
 
 	Semaphores* imageIsReadyForRenderSemaphores;
 	Semaphores* imageFinishedRenderSemaphores;
 	Fences* frameInFlightFences;
 	Fences* imageInFlightFences;
 
+	BenchmarkSettings benchmarkSettings;
+	Benchmark* benchmark = nullptr;
+
 	int currentFrame = 0;
+	bool modelStatisticsPrinted = false;
 	std::chrono::time_point<std::chrono::steady_clock> startTime;
 	std::chrono::time_point<std::chrono::steady_clock> lastFrameTime;
 	std::chrono::time_point<std::chrono::steady_clock> currentFrameTime;
 };
 
-Application::Application() {
+Application::Application(BenchmarkSettings inBenchmarkSettings) {
+	benchmarkSettings = inBenchmarkSettings;
 	init();
 }
 
 void Application::init() {
 	camera			= new Camera(glm::vec3(-36.0, 0.0, 21.0), glm::vec3(0.0, 0.0, 1.0), 0.0f, -30.0f);
-	inputManager	= new UserInputManager(camera);
-	window			= new Window(800, 600, inputManager);
-	debugger		= new ValidationDebugger(true);
-	instance		= new Instance(debugger);
-	window->setInstanceRef(instance);
-	window->createVulkanSurface();
+	inputManager	= new UserInputManager(camera, benchmarkSettings.instanceCount);
+	window			= isHeadless() ? nullptr : new Window(800, 600, inputManager);
+	debugger		= new ValidationDebugger(!isHeadless());
+	instance		= new Instance(debugger, !isHeadless());
+	if (!isHeadless()) {
+		window->setInstanceRef(instance);
+		window->createVulkanSurface();
+	}
 
 	physicalDevice	= new PhysicalDevice(instance, window);
 	device			= new LogicalDevice(physicalDevice, debugger);
-	swapChain		= new SwapChain(device, window);
+	allocator		= new MemoryAllocator(device);
+	device->setAllocator(allocator);
+	if (isHeadless())
+		swapChain	= new SwapChain(device, { benchmarkSettings.width, benchmarkSettings.height }, MAX_IN_FLIGHT + 1);
+	else
+		swapChain	= new SwapChain(device, window);
 
 	commandPool		= new CommandPool(device);
-	descriptorPool	= new DescriptorPool(device, swapChain);
+	uploadManager	= new UploadManager(device);
+	descriptorPool	= new DescriptorPool(device, MAX_IN_FLIGHT);
 
 	colorResource	= nullptr;
 	depthResouce	= new DepthResource(device, swapChain, commandPool);
 
 	descriptorSetLayout = new DescriptorSetLayout(device);
-	renderPass		= new RenderPass(device, swapChain, colorResource, depthResouce);
+	renderPass		= new RenderPass(device, swapChain, depthResouce);
 
-	vertexLayout = new VertexLayout({
-		VERTEX_COMPONENT_POSITION,
-		VERTEX_COMPONENT_NORMAL,
-		VERTEX_COMPONENT_UV,
-		VERTEX_COMPONENT_COLOR,
+	// 20 bytes per vertex instead of 44 with float components, positions in their own
+	// stream so the depth prepass fetches 8 of them
+	vertexLayout = new VertexLayout(std::vector<std::vector<Component>>{
+		{ VERTEX_COMPONENT_POSITION_HALF },
+		{ VERTEX_COMPONENT_NORMAL_OCT, VERTEX_COMPONENT_UV_UNORM16, VERTEX_COMPONENT_COLOR_UNORM8 },
 	});
 
-	pipeline		= new Pipeline(device, swapChain, descriptorSetLayout, renderPass, vertexLayout);
+	pipelineCache	= new PipelineCache(device);
+	threadPool		= new ThreadPool();
+	pipeline		= new Pipeline(device, descriptorSetLayout, renderPass, vertexLayout, pipelineCache, threadPool, benchmarkSettings.depthPrepass);
+
+	framebuffers	= new Framebuffers(device, renderPass, swapChain, depthResouce);
+	uniformBuffers	= new UniformBuffers(device, MAX_IN_FLIGHT, inputManager->getModelCount());
+	objectBuffer	= new ObjectBuffer(device, MAX_IN_FLIGHT, inputManager->getModelCount());
 
-	framebuffers	= new Framebuffers(device, renderPass, swapChain);
-	uniformBuffers	= new UniformBuffers(device, swapChain);
+	// texture			= new Texture(device, "textures/house.jpg", uploadManager);
+	geometryPool	= new GeometryPool(device, uploadManager, vertexLayout);
+	loaderPool		= new ThreadPool(LOADER_THREAD_COUNT);
+	model			= new AssimpModel(device, uploadManager, vertexLayout, loaderPool, geometryPool);
+	lodSelector		= new LodSelector(model);
+	meshletCuller	= new MeshletCuller(model);
+	renderQueue		= new RenderQueue();
+	uploadManager->submit();
 
-	// texture			= new Texture(device, "textures/house.jpg", commandPool);
-	model			= new AssimpModel(device, commandPool, vertexLayout);
+	descriptorSets	= new DescriptorSets(device, descriptorSetLayout, descriptorPool, uniformBuffers, objectBuffer, nullptr);
 
-	descriptorSets	= new DescriptorSets(device, descriptorSetLayout, descriptorPool, uniformBuffers, nullptr);
+	if (isHeadless())
+		benchmark	= new Benchmark(device, benchmarkSettings, MAX_IN_FLIGHT);
 
-	drawCommands	= new DrawCommands(device, swapChain, commandPool, renderPass, framebuffers, uniformBuffers, pipeline, model, descriptorSets);
+	drawCommands	= new DrawCommands(device, swapChain, renderPass, framebuffers, uniformBuffers, objectBuffer, pipeline, geometryPool, descriptorSets,
+		threadPool, MAX_IN_FLIGHT, benchmark ? benchmark->getQueryPool() : VK_NULL_HANDLE);
+	deletionQueue	= new DeletionQueue(MAX_IN_FLIGHT);
 
 	imageIsReadyForRenderSemaphores = new Semaphores(device, MAX_IN_FLIGHT);
 	imageFinishedRenderSemaphores	= new Semaphores(device, MAX_IN_FLIGHT);
 	frameInFlightFences				= new Fences(device, MAX_IN_FLIGHT);
 	frameInFlightFences->createFences();
 	imageInFlightFences				= new Fences(device, swapChain->getImageCount());
+
+	if (!isHeadless())
+		allocator->printStatistics();
 }
 
 
 void Application::run() {
+	if (isHeadless()) {
+		runBenchmark();
+		return;
+	}
+
 	std::cout << "Start rendering.\n";
-	startTime = lastFrameTime = std::chrono::high_resolution_clock::now();
+	startTime = lastFrameTime = std::chrono::steady_clock::now();
 	while (!glfwWindowShouldClose(window->glfwWindow)) {
-		currentFrameTime = std::chrono::high_resolution_clock::now();
+		currentFrameTime = std::chrono::steady_clock::now();
 		float deltaTime = std::chrono::duration<float, std::chrono::seconds::period>(currentFrameTime - lastFrameTime).count();
 
 		inputManager->keyPressManager(window->glfwWindow, deltaTime);
@@ -157,41 +231,98 @@ void Application::run() {
 	cleanup();
 }
 
+void Application::runBenchmark() {
+	std::cout << "Start benchmark: " << benchmarkSettings.frameCount << " frames at "
+		<< benchmarkSettings.width << "x" << benchmarkSettings.height << ".\n";
+	// Frames are only comparable with the whole scene in place.
+	model->finishLoading(deletionQueue);
+	// On a cold pipeline cache the first frames would otherwise draw nothing.
+	for (uint32_t i = 0; i < pipeline->getPipelineCount(); ++i) {
+		pipeline->getPipelineFuture(i).wait();
+		if (pipeline->hasFailed(i))
+			throw std::runtime_error("Failed to compile the pipelines for the benchmark.");
+	}
+	while (!benchmark->isFinished()) {
+		benchmark->updateCamera(camera);
+		drawFrame();
+		benchmark->endFrame();
+	}
+	vkDeviceWaitIdle(device->getDevice());
+	benchmark->collectAllGpuTimes();
+	benchmark->writeReport(swapChain->getExtent());
+	cleanup();
+}
+
 void Application::drawFrame() {
 
 	vkWaitForFences(device->getDevice(), 1, &frameInFlightFences->getFence(currentFrame), VK_TRUE, UINT64_MAX);
+	deletionQueue->collect();
 
 	uint32_t swapChainIndex;
-	acquireNextSwapChainImageIndex(swapChainIndex);
+	if (isHeadless())
+		swapChainIndex = benchmark->getFrameIndex() % swapChain->getImageCount();
+	else if (!acquireNextSwapChainImageIndex(swapChainIndex))
+		return;
 	waitForSwapChainImageReady(swapChainIndex);
+
+	if (benchmark) {
+		benchmark->collectGpuTime(currentFrame);
+		benchmark->beginCpuWork();
+	}
 	
-	updateUniformBuffer(swapChainIndex);
-	updateDynamicUniformBuffer(swapChainIndex);
+	uniformBuffers->beginFrame(currentFrame);
+	updateUniformBuffer();
+	updateObjectBuffer();
+
+	model->update(deletionQueue);
+	// Interactive runs only, benchmark results own stdout.
+	if (!isHeadless() && !modelStatisticsPrinted && model->isLoaded()) {
+		model->printStatistics();
+		modelStatisticsPrinted = true;
+	}
+	geometryPool->update(deletionQueue);
+	updateDrawItems();
+	updateInstanceBuffer();
+	uniformBuffers->flush();
+	drawCommands->recordCommands(currentFrame, swapChainIndex, renderQueue->getSortedItems());
+	if (benchmark) {
+		DrawStatistics drawStatistics = drawCommands->getStatistics();
+		benchmark->recordStateChanges(drawStatistics.getStateChanges(), drawStatistics.getStateChangesAvoided());
+	}
 
 	VkSubmitInfo submitInfo{};
 	VkSemaphore waitSemaphores[] = { imageIsReadyForRenderSemaphores->getSemaphore(currentFrame) };
 	VkSemaphore signalSemaphores[] = { imageFinishedRenderSemaphores->getSemaphore(currentFrame) };
 	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	setupSubmitInfo(submitInfo, swapChainIndex, waitSemaphores, signalSemaphores, waitStages);
+	setupSubmitInfo(submitInfo, waitSemaphores, signalSemaphores, waitStages);
 
 	submitDrawCommands(submitInfo);
-	
-	presentImage(&swapChainIndex, signalSemaphores);
+	deletionQueue->endFrame();
+
+	if (benchmark) {
+		benchmark->endCpuWork();
+		benchmark->markGpuSlot(currentFrame);
+	}
+	else {
+		presentImage(&swapChainIndex, signalSemaphores);
+	}
 
 	currentFrame = (currentFrame + 1) % MAX_IN_FLIGHT;
 }
 
-void Application::acquireNextSwapChainImageIndex(uint32_t& imageIndex) {
+bool Application::acquireNextSwapChainImageIndex(uint32_t& imageIndex) {
 	VkResult result = vkAcquireNextImageKHR(device->getDevice(), swapChain->getSwapChain(), UINT64_MAX,
 		imageIsReadyForRenderSemaphores->getSemaphore(currentFrame), VK_NULL_HANDLE, &imageIndex);
 	 
+	// Nothing was acquired, so the frame is skipped rather than rendered into a stale image index.
 	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 		windowResize();
-		return;
+		return false;
 	}
 	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
 		throw std::runtime_error("Failed to acquire next swap chain image");
 	}
+	return true;
 }
 
 void Application::waitForSwapChainImageReady(uint32_t swapChainIndex) {
@@ -200,36 +331,133 @@ void Application::waitForSwapChainImageReady(uint32_t swapChainIndex) {
 	imageInFlightFences->setFence(frameInFlightFences->getFence(currentFrame), swapChainIndex);
 }
 
-void Application::updateUniformBuffer(uint32_t swapChainIndex) {
-	uniformBuffers->ubo.view = camera->getViewMatrix();
-	uniformBuffers->ubo.proj = glm::perspective(glm::radians(camera->zoom), swapChain->getExtent().width / (float)swapChain->getExtent().height, 0.1f, 50.0f);
-	uniformBuffers->ubo.proj[1][1] *= -1;
+glm::mat4 Application::getProjectionMatrix() {
+	glm::mat4 proj = glm::perspective(glm::radians(camera->zoom), swapChain->getExtent().width / (float)swapChain->getExtent().height, 0.1f, FAR_PLANE);
+	proj[1][1] *= -1;
+	return proj;
+}
+
+void Application::updateUniformBuffer() {
+	uint32_t offset;
+	UniformBufferObject* ubo = static_cast<UniformBufferObject*>(uniformBuffers->allocate(sizeof(UniformBufferObject), offset));
+	ubo->view = camera->getViewMatrix();
+	ubo->proj = getProjectionMatrix();
 
 	for (int i = 0; i < 3; ++i)
-		uniformBuffers->ubo.lightPos[i] = inputManager->getLightPos(i);
+		ubo->lightPos[i] = inputManager->getLightPos(i);
+
+	ubo->cameraPos = glm::vec4(camera->position, 0.0);
+}
 
-	uniformBuffers->ubo.cameraPos = glm::vec4(camera->position, 0.0);
+void Application::updateObjectBuffer() {
+	// Only objects that moved since the last frame are rebuilt and uploaded. Their matrices are kept
+	// for culling and LOD selection.
+	objectMatrices.resize(inputManager->getModelCount());
+	objectBuffer->resize(inputManager->getModelCount());
+	for (uint32_t i : inputManager->takeDirtyObjects()) {
+		objectMatrices[i] = inputManager->getModelMatrix(i);
+		objectBuffer->setObject(i, objectMatrices[i], i % PIPELINE_SHADING_COUNT);
+	}
+	objectBuffer->prepareFrame(currentFrame, deletionQueue);
+	descriptorSets->updateObjectBuffer(currentFrame);
+}
 
-	uniformBuffers->getBufferRef(swapChainIndex)->copyDataToBuffer(&uniformBuffers->ubo);
+void Application::updateInstanceBuffer() {
+	uint32_t offset;
+	void* instanceData = uniformBuffers->allocate(uniformBuffers->getInstanceArraySize(), offset);
+	if (!instances.empty())
+		memcpy(instanceData, instances.data(), instances.size() * sizeof(uint32_t));
 }
 
-void Application::updateDynamicUniformBuffer(uint32_t swapChainIndex) {
-	for (uint32_t i = 0; i < 3; ++i) {
-		glm::mat4* modelMat = (glm::mat4*)((uint64_t)uniformBuffers->dynamicUbo.model + ((uint64_t)i * uniformBuffers->getDynamicAlignment()));
-		*modelMat = inputManager->getModelMatrix(i);
+void Application::updateDrawItems() {
+	// Objects whose pipeline is still compiling or whose model has no geometry yet are left out until they are ready.
+	renderQueue->clear();
+	instances.clear();
+	// Shading pipelines do not write depth when there is a prepass, so nothing is drawn without it.
+	// If it failed to compile, the pipelines are rebuilt without one.
+	if (pipeline->hasDepthPrepass() && pipeline->hasFailed(PIPELINE_DEPTH_PREPASS))
+		replacePipeline(false);
+	if (pipeline->hasDepthPrepass() && !pipeline->isReady(PIPELINE_DEPTH_PREPASS)) {
+		renderQueue->sort();
+		return;
+	}
+	lodSelector->setView(camera->position, camera->zoom, swapChain->getExtent().height);
+	meshletCuller->beginFrame(getProjectionMatrix() * camera->getViewMatrix(), camera->position);
+
+	// Objects showing the same model at the same level of detail with the same pipeline are drawn together.
+	instanceGroups.resize(model->getModelCount() * MESH_MAX_LODS * PIPELINE_SHADING_COUNT);
+	for (auto& group : instanceGroups)
+		group.clear();
+	for (uint32_t i = 0; i < inputManager->getModelCount(); ++i) {
+		uint32_t shading = i % PIPELINE_SHADING_COUNT;
+		int modelIndex = inputManager->getModelIndex(i);
+		if (!pipeline->isReady(shading) || !model->isAvailable(modelIndex))
+			continue;
+		uint32_t lod = lodSelector->select(i, modelIndex, objectMatrices[i]);
+		instanceGroups[(modelIndex * MESH_MAX_LODS + lod) * PIPELINE_SHADING_COUNT + shading].push_back(i);
+	}
+
+	for (size_t g = 0; g < instanceGroups.size(); ++g) {
+		const std::vector<uint32_t>& group = instanceGroups[g];
+		if (group.empty())
+			continue;
+		uint32_t shading = g % PIPELINE_SHADING_COUNT;
+		uint32_t lod = (g / PIPELINE_SHADING_COUNT) % MESH_MAX_LODS;
+		int modelIndex = static_cast<int>(g / (PIPELINE_SHADING_COUNT * MESH_MAX_LODS));
+		// Instances share their index ranges, so they are culled as whole objects instead of per meshlet.
+		bool instanced = group.size() > 1;
+		uint32_t firstInstance = static_cast<uint32_t>(instances.size());
+		for (uint32_t object : group)
+			if (!instanced || meshletCuller->isVisible(modelIndex, objectMatrices[object]))
+				instances.push_back(object);
+		uint32_t instanceCount = static_cast<uint32_t>(instances.size()) - firstInstance;
+		if (instanceCount == 0)
+			continue;
+		// Groups sort by their nearest visible instance.
+		float distance = FAR_PLANE;
+		for (uint32_t i = firstInstance; i < instances.size(); ++i)
+			distance = std::min(distance, glm::distance(camera->position, glm::vec3(objectMatrices[instances[i]][3])));
+		float depth = distance / FAR_PLANE;
+		// One draw per part, each with the index type and vertex offset its indices were rebased to.
+		for (uint32_t part = 0; part < model->getPartCount(modelIndex); ++part) {
+			uint32_t indexCount = model->getIndexCount(modelIndex, part, lod);
+			if (indexCount == 0)
+				continue;
+			DrawConstants constants{ instanced ? DRAW_OBJECT_FROM_INSTANCE : group[0], lod, shading };
+			DrawItem item{ pipeline->getPipeline(shading), constants, firstInstance, instanceCount, model->getIndexType(modelIndex, part),
+				indexCount, model->getIndexOffset(modelIndex, part, lod), model->getVertexOffset(modelIndex, part) };
+			culledItems.clear();
+			if (instanced)
+				culledItems.push_back(item);
+			else
+				meshletCuller->cull(item, modelIndex, part, lod, objectMatrices[group[0]], culledItems);
+			for (DrawItem& culledItem : culledItems) {
+				renderQueue->push(RenderQueue::makeKey(RENDER_PASS_SHADING, shading, culledItem.indexType, shading, lod, depth), culledItem);
+				// The prepass sorts ahead of shading, so the whole scene is in the depth buffer before any pixel is shaded.
+				// Its shaders read no material, so all its draws share one and only the level of detail splits them.
+				if (pipeline->hasDepthPrepass()) {
+					culledItem.pipeline = pipeline->getDepthPrepassPipeline();
+					culledItem.constants.material = 0;
+					renderQueue->push(RenderQueue::makeKey(RENDER_PASS_DEPTH_PREPASS, PIPELINE_DEPTH_PREPASS, culledItem.indexType, 0, lod, depth), culledItem);
+				}
+			}
+		}
 	}
-	uniformBuffers->getDynamicBufferRef(swapChainIndex)->copyDataToBufferFlush(uniformBuffers->dynamicUbo.model);
+	renderQueue->sort();
+	if (benchmark)
+		benchmark->recordCulledTriangles(meshletCuller->getStatistics().trianglesCulled);
 }
 
-void Application::setupSubmitInfo(VkSubmitInfo& submitInfo, uint32_t swapChainIndex, 
+void Application::setupSubmitInfo(VkSubmitInfo& submitInfo,
 	VkSemaphore *waitSemaphores, VkSemaphore* signalSemaphores, VkPipelineStageFlags* waitStages) {
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.waitSemaphoreCount = 1;
+	// Offscreen images are neither acquired nor presented, so there is nothing to wait on or signal.
+	submitInfo.waitSemaphoreCount = isHeadless() ? 0 : 1;
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &drawCommands->getCommandBufferRef(swapChainIndex)->getCommandBuffer();
-	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pCommandBuffers = &drawCommands->getCommandBufferRef(currentFrame)->getCommandBuffer();
+	submitInfo.signalSemaphoreCount = isHeadless() ? 0 : 1;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 }
 
@@ -267,8 +495,6 @@ void Application::windowResize() {
 	window->setWidth(width);
 	window->setHeight(height);
 	
-	vkDeviceWaitIdle(device->getDevice());
-	cleanupSwapChainRelated();
 	recreateSwapChainRelated();
 	window->resetResized();
 }
@@ -278,33 +504,79 @@ void Application::cleanupSwapChainRelated() {
 	delete framebuffers;
 	delete drawCommands;
 	delete uniformBuffers;
-	delete descriptorPool;
+	delete objectBuffer;
 	delete descriptorSets;
+	delete descriptorPool;
 	delete renderPass;
 	delete swapChain;
 }
 
 void Application::recreateSwapChainRelated() {
-	swapChain = new SwapChain(device, window);
-	uniformBuffers = new UniformBuffers(device, swapChain);
-	descriptorPool = new DescriptorPool(device, swapChain);
+	// Only the swap chain and the attachments sized to it are rebuilt, plus the render pass and pipelines
+	// if the format changed. Everything per frame in flight stays, and the retired objects are destroyed
+	// once the frames that used them have finished.
+	SwapChain* oldSwapChain = swapChain;
+	swapChain = new SwapChain(device, window, oldSwapChain);
+
+	retireSwapChainRelated(oldSwapChain);
 	depthResouce = new DepthResource(device, swapChain, commandPool);
-	renderPass = new RenderPass(device, swapChain, colorResource, depthResouce);
-	descriptorSets = new DescriptorSets(device, descriptorSetLayout, descriptorPool, uniformBuffers, nullptr);
-	framebuffers = new Framebuffers(device, renderPass, swapChain);
-	drawCommands = new DrawCommands(device, swapChain, commandPool, renderPass, framebuffers, uniformBuffers, pipeline, model, descriptorSets);
+	// The surface format can change too, e.g. when the window moves to an HDR monitor.
+	if (swapChain->getFormat() != renderPass->getColorFormat())
+		recreateRenderPass();
+	framebuffers = new Framebuffers(device, renderPass, swapChain, depthResouce);
+	drawCommands->setRenderTargets(swapChain, framebuffers);
+	imageInFlightFences->resize(swapChain->getImageCount());
+}
+
+void Application::retireSwapChainRelated(SwapChain* oldSwapChain) {
+	DepthResource* oldDepthResource = depthResouce;
+	Framebuffers* oldFramebuffers = framebuffers;
+	deletionQueue->push([oldSwapChain, oldDepthResource, oldFramebuffers] {
+		delete oldFramebuffers;
+		delete oldDepthResource;
+		delete oldSwapChain;
+	});
+}
+
+void Application::recreateRenderPass() {
+	// Pipelines are built against the render pass, so both are replaced. Frames in flight still use the
+	// old ones, and the old pipelines' destructor waits for compilations that are still running.
+	RenderPass* oldRenderPass = renderPass;
+	renderPass = new RenderPass(device, swapChain, depthResouce);
+	replacePipeline(pipeline->hasDepthPrepass());
+	deletionQueue->push([oldRenderPass] { delete oldRenderPass; });
+}
+
+void Application::replacePipeline(bool depthPrepass) {
+	// Queued entries run in order, so the old pipelines are gone before a render pass queued after them.
+	Pipeline* oldPipeline = pipeline;
+	deletionQueue->push([oldPipeline] { delete oldPipeline; });
+	pipeline = new Pipeline(device, descriptorSetLayout, renderPass, vertexLayout, pipelineCache, threadPool, depthPrepass);
+	drawCommands->setRenderPass(renderPass, pipeline);
 }
 
 void Application::cleanup() {
+	delete deletionQueue;
+	// Waits for compilations still running, which use the render pass and the descriptor set layout.
+	delete pipeline;
 	cleanupSwapChainRelated();
+	delete benchmark;
 	delete imageIsReadyForRenderSemaphores;
 	delete imageFinishedRenderSemaphores;
 	delete frameInFlightFences;
 	delete descriptorSetLayout;
-	delete pipeline;
+	delete pipelineCache;
+	delete threadPool;
+	delete renderQueue;
+	delete meshletCuller;
+	delete lodSelector;
 	delete model;
+	delete loaderPool;
+	delete geometryPool;
 	// delete texture;
+	delete uploadManager;
 	delete commandPool;
+	delete allocator;
 	delete device;
 	delete physicalDevice;
 	delete window;
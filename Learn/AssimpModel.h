@@ -9,6 +9,12 @@
 #pragma once
 
 #include <stdlib.h>
+#include <atomic>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <fstream>
 #include <vector>
@@ -21,93 +27,27 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include "Buffer.h"
+#include "UploadManager.h"
 #include "ModelMatrix.h"
-
-typedef enum Component {
-	VERTEX_COMPONENT_POSITION = 0x0,
-	VERTEX_COMPONENT_NORMAL = 0x1,
-	VERTEX_COMPONENT_COLOR = 0x2,
-	VERTEX_COMPONENT_UV = 0x3,
-	VERTEX_COMPONENT_TANGENT = 0x4,
-	VERTEX_COMPONENT_BITANGENT = 0x5,
-	VERTEX_COMPONENT_DUMMY_FLOAT = 0x6,
-	VERTEX_COMPONENT_DUMMY_VEC4 = 0x7
-} Component;
-
-struct VertexLayout {
-public:
-	std::vector<Component> components;
-
-	VertexLayout(std::vector<Component> components) {
-		this->components = std::move(components);
-	}
-
-	uint32_t stride() {
-		uint32_t res = 0;
-		for (auto& component : components) {
-			switch (component)
-			{
-			case VERTEX_COMPONENT_UV:
-				res += 2 * sizeof(float);
-				break;
-			case VERTEX_COMPONENT_DUMMY_FLOAT:
-				res += sizeof(float);
-				break;
-			case VERTEX_COMPONENT_DUMMY_VEC4:
-				res += 4 * sizeof(float);
-				break;
-			default:
-				res += 3 * sizeof(float);
-			}
-		}
-		return res;
-	}
-
-	VkVertexInputBindingDescription getBindingDescription() {
-		VkVertexInputBindingDescription bindingDescription{};
-		bindingDescription.binding = 0;
-		bindingDescription.stride = stride();
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		return bindingDescription;
-	}
-
-	static std::vector<VkVertexInputAttributeDescription> getVertexInputAttributeDescriptions() {
-		std::vector<VkVertexInputAttributeDescription> attributeDescriptions(4);
-		// position
-		attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[0].offset = 0;
-		
-		// normal
-		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = sizeof(float) * 3;
-
-		// uv
-		attributeDescriptions[2].binding = 0;
-		attributeDescriptions[2].location = 2;
-		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[2].offset = sizeof(float) * 6;
-
-		// color
-		attributeDescriptions[3].binding = 0;
-		attributeDescriptions[3].location = 3;
-		attributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[3].offset = sizeof(float) * 8;
-
-		return attributeDescriptions;
-	}
-};
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include "ThreadPool.h"
+#include "DeletionQueue.h"
+#include "GeometryPool.h"
+#include "VertexLayout.h"
 
 struct ModelCreateInfo {
 	glm::vec3 center;
 	glm::vec3 scale;
 	glm::vec2 uvscale;
 	VkMemoryPropertyFlags memoryPropertyFlags = 0;
+	bool optimize = true;
+	bool generateLods = true;
 
 	ModelCreateInfo() : center(glm::vec3(0.0f)), scale(glm::vec3(1.0f)), uvscale(glm::vec2(1.0f)) {};
 
@@ -124,54 +64,120 @@ struct ModelCreateInfo {
 	}
 };
 
+struct ModelFile {
+	std::string filename;
+	ModelCreateInfo createInfo;
+};
+
+// Loads its models in the background. The constructor only queues the imports on the loader pool,
+// and update() moves every model through its states on the render thread: nothing is drawn until its
+// bounds are known, then a box over the bounds stands in until the real vertices and indices have
+// been uploaded. Each state is swapped in the frame its upload batch has signaled, without waiting.
+// The geometry of every state lives in the shared geometry pool.
 class AssimpModel {
 public:
-	AssimpModel(LogicalDevice* inDevice, CommandPool* inPool, VertexLayout* inVertexLayout) {
+	AssimpModel(LogicalDevice* inDevice, UploadManager* inUploadManager, VertexLayout* inVertexLayout, ThreadPool* inThreadPool, GeometryPool* inGeometryPool) {
 		device = inDevice;
-		commandPool = inPool;
+		uploadManager = inUploadManager;
 		vertexLayout = inVertexLayout;
-		vertexData.resize(0);
-		indexData.resize(0);
-		dataOffset.resize(3);
-		loadModel("models/chinesedragon.dae", 0);
-		loadModel("models/teapot.dae", 1);
-		loadModel("models/treasure.dae", 2);
-		createVertexBuffer();
-		createIndexBuffer();
+		threadPool = inThreadPool;
+		geometryPool = inGeometryPool;
+		std::vector<ModelFile> files = {
+			{ "models/chinesedragon.dae", ModelCreateInfo(1.0f, 1.0f, 0.0f) },
+			{ "models/teapot.dae", ModelCreateInfo(1.0f, 1.0f, 0.0f) },
+			{ "models/treasure.dae", ModelCreateInfo(1.0f, 1.0f, 0.0f) },
+		};
+		loadModels(files);
 	}
 
 	~AssimpModel() {
-		delete vertexBuffer;
-		delete indexBuffer;
+		// Imports still running write into the load records, so they finish before those go away.
+		loading.wait();
+		for (auto& load : loads) {
+			if (load->placeholder.geometry != INVALID_GEOMETRY_HANDLE && !load->finished)
+				geometryPool->remove(load->placeholder.geometry);
+			if (load->loaded.geometry != INVALID_GEOMETRY_HANDLE)
+				geometryPool->remove(load->loaded.geometry);
+		}
 	}
 
-	Buffer* getVertexBufferRef() { return vertexBuffer; }
-	Buffer* getIndexBufferRef() { return indexBuffer; }
-	uint32_t getIndexOffset(int index) { return dataOffset[index].indexBase; }
-	uint32_t getIndexCount(int index) { return dataOffset[index].indexCount; }
-	uint32_t getVertexOffset(int index) { return dataOffset[index].vertexCount; }
+	void update(DeletionQueue* deletionQueue);
+	void finishLoading(DeletionQueue* deletionQueue);
+	bool isLoaded();
+	void printStatistics();
+
+	/** @brief Whether the model has geometry to draw, either its placeholder or its real data */
+	bool isAvailable(int index) { return dataOffset[index].geometry != INVALID_GEOMETRY_HANDLE; }
+	uint32_t getModelCount() { return static_cast<uint32_t>(dataOffset.size()); }
+	uint32_t getPartCount(int index) { return dataOffset[index].partCount; }
+	VkIndexType getIndexType(int index, uint32_t part) { return getPart(index, part).indexType; }
+	/** @brief First index of a part's LOD in the pool's index buffer, counted in elements of the part's index type */
+	uint32_t getIndexOffset(int index, uint32_t part, uint32_t lod = 0) {
+		PartOffset& partOffset = getPart(index, part);
+		return geometryPool->getIndexBase(dataOffset[index].geometry, partOffset.indexType) + partOffset.lods[lod].indexBase;
+	}
+	uint32_t getIndexCount(int index, uint32_t part, uint32_t lod = 0) { return getPart(index, part).lods[lod].indexCount; }
+	int32_t getVertexOffset(int index, uint32_t part) { return static_cast<int32_t>(geometryPool->getVertexBase(dataOffset[index].geometry) + getPart(index, part).vertexBase); }
+	uint32_t getLodCount(int index) { return dataOffset[index].lodCount; }
+	float getLodError(int index, uint32_t lod) { return dataOffset[index].lodErrors[lod]; }
+	const Meshlet* getMeshlets(int index, uint32_t part, uint32_t lod) { return meshlets.data() + getPart(index, part).lods[lod].meshletBase; }
+	uint32_t getMeshletCount(int index, uint32_t part, uint32_t lod) { return getPart(index, part).lods[lod].meshletCount; }
+	/** @brief Bounding sphere of a model in model space, radius in w */
+	glm::vec4 getBoundingSphere(int index) { return dataOffset[index].boundingSphere; }
 
 
 private:
 	LogicalDevice* device;
-	CommandPool* commandPool;
+	UploadManager* uploadManager;
 	VertexLayout* vertexLayout;
+	ThreadPool* threadPool;
+	GeometryPool* geometryPool;
 
-	Buffer* vertexBuffer;
-	Buffer* indexBuffer;
+	// Culling bounds of all loaded models, index ranges are relative to the start of their LOD's range
+	std::vector<Meshlet> meshlets;
 
-	std::vector<float> vertexData;
-	std::vector<uint32_t> indexData;
+	/** @brief Draw ranges of one part within its pool allocation; its indices are relative to vertexBase so they fit 16 bits whenever its vertices do */
+	struct PartOffset {
+		uint32_t vertexBase;
+		VkIndexType indexType;
+		MeshLod lods[MESH_MAX_LODS];
+	};
+	std::vector<PartOffset> partOffsets;
 
-	/** @brief Stores vertex and index base and counts for each part of a model */
+	/** @brief Stores the geometry, parts and levels of detail of a model */
 	struct DataOffset {
-		uint32_t vertexBase;
+		GeometryHandle geometry = INVALID_GEOMETRY_HANDLE;
 		uint32_t vertexCount;
-		uint32_t indexBase;
-		uint32_t indexCount;
+		uint32_t partBase;
+		uint32_t partCount;
+		uint32_t lodCount;
+		// Largest error of any part at each level
+		float lodErrors[MESH_MAX_LODS];
+		glm::vec4 boundingSphere;
 	};
+	// What is drawn for each model this frame
 	std::vector<DataOffset> dataOffset;
 
+	/** @brief Progress of one model file; the worker only writes mesh and error before setting imported */
+	struct ModelLoad {
+		ModelFile file;
+		MeshData mesh;
+		// Only measured when the mesh was optimized by this run, not when it came from the cache
+		bool optimized = false;
+		MeshOptimizationStatistics optimization;
+		std::exception_ptr error;
+		// Published by the worker as soon as the source is read, before the mesh is processed
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		std::atomic<bool> boundsKnown{ false };
+		std::atomic<bool> imported{ false };
+		DataOffset placeholder;
+		DataOffset loaded;
+		bool finished = false;
+	};
+	std::vector<std::unique_ptr<ModelLoad>> loads;
+	JobGroup loading;
+
 	struct Dimension {
 		glm::vec3 min = glm::vec3(FLT_MAX);
 		glm::vec3 max = glm::vec3(-FLT_MAX);
@@ -187,18 +193,156 @@ private:
 		aiProcess_CalcTangentSpace | 
 		aiProcess_GenSmoothNormals;
 
-	void loadModel(const std::string& filename, int modelIndex);
-	void loadFromFile(const std::string& filename, ModelCreateInfo* createInfo, int modelIndex);
-	void createVertexBuffer();
-	void createIndexBuffer();
+	void loadModels(std::vector<ModelFile>& files);
+	void loadFromFile(const std::string& filename, ModelCreateInfo* createInfo, MeshData& mesh, ModelLoad& load);
+	uint64_t hashImportSettings(ModelCreateInfo* createInfo);
+	void importFromFile(const std::string& filename, ModelCreateInfo* createInfo, MeshData& mesh);
+	void createPlaceholder(glm::vec3 boundsMin, glm::vec3 boundsMax, DataOffset& offset);
+	void appendMesh(const MeshData& mesh, DataOffset& offset);
+	PartOffset& getPart(int index, uint32_t part) { return partOffsets[dataOffset[index].partBase + part]; }
 };
 
-void AssimpModel::loadModel(const std::string& filename, int modelIndex) {
-	ModelCreateInfo modelCreateInfo(1.0f, 1.0f, 0.0f);
-	loadFromFile(filename, &modelCreateInfo, modelIndex);
+void AssimpModel::loadModels(std::vector<ModelFile>& files) {
+	// Every file is imported on its own worker into its own MeshData. Files with a cache entry
+	// already know their bounds, so their placeholders are uploaded right away. The others publish
+	// their bounds once the source has been read, ahead of optimization, LODs and meshlets.
+	dataOffset.resize(files.size());
+	for (size_t i = 0; i < files.size(); ++i) {
+		loads.push_back(std::unique_ptr<ModelLoad>(new ModelLoad()));
+		ModelLoad* load = loads.back().get();
+		load->file = files[i];
+
+		MeshCache cache(load->file.filename, hashImportSettings(&load->file.createInfo), vertexLayout->stride());
+		glm::vec3 boundsMin, boundsMax;
+		if (cache.loadBounds(boundsMin, boundsMax))
+			createPlaceholder(boundsMin, boundsMax, load->placeholder);
+
+		threadPool->enqueue(loading, [this, load] {
+			try {
+				loadFromFile(load->file.filename, &load->file.createInfo, load->mesh, *load);
+			}
+			catch (...) {
+				load->error = std::current_exception();
+			}
+			load->imported = true;
+		});
+	}
+}
+
+void AssimpModel::update(DeletionQueue* deletionQueue) {
+	// Imports that finished since the last frame are added to the pool.
+	for (auto& load : loads) {
+		if (load->finished || load->loaded.geometry != INVALID_GEOMETRY_HANDLE)
+			continue;
+		if (load->placeholder.geometry == INVALID_GEOMETRY_HANDLE && load->boundsKnown)
+			createPlaceholder(load->boundsMin, load->boundsMax, load->placeholder);
+		if (!load->imported)
+			continue;
+		if (load->error)
+			std::rethrow_exception(load->error);
+		appendMesh(load->mesh, load->loaded);
+		load->mesh = MeshData();
+	}
+
+	// Frames still in flight may draw the placeholder, so it is only destroyed after them.
+	for (size_t i = 0; i < loads.size(); ++i) {
+		ModelLoad& load = *loads[i];
+		if (load.finished)
+			continue;
+		if (load.loaded.geometry != INVALID_GEOMETRY_HANDLE && geometryPool->isResident(load.loaded.geometry)) {
+			dataOffset[i] = load.loaded;
+			load.finished = true;
+			if (load.placeholder.geometry != INVALID_GEOMETRY_HANDLE)
+				geometryPool->remove(load.placeholder.geometry, deletionQueue);
+		}
+		else if (load.placeholder.geometry != INVALID_GEOMETRY_HANDLE && dataOffset[i].geometry == INVALID_GEOMETRY_HANDLE &&
+			geometryPool->isResident(load.placeholder.geometry)) {
+			dataOffset[i] = load.placeholder;
+		}
+	}
+}
+
+void AssimpModel::finishLoading(DeletionQueue* deletionQueue) {
+	loading.wait();
+	update(deletionQueue);
+	uploadManager->waitIdle();
+	// Lets a grown pool switch to its new buffers, so the meshes count as resident.
+	geometryPool->update(deletionQueue);
+	update(deletionQueue);
+}
+
+bool AssimpModel::isLoaded() {
+	for (auto& load : loads)
+		if (!load->finished)
+			return false;
+	return true;
+}
+
+void AssimpModel::loadFromFile(const std::string& filename, ModelCreateInfo* createInfo, MeshData& mesh, ModelLoad& load) {
+	// Runs on a worker thread, so it only touches its own load record and Importer.
+	MeshCache cache(filename, hashImportSettings(createInfo), vertexLayout->stride());
+	bool cached = cache.load(mesh);
+	if (!cached)
+		importFromFile(filename, createInfo, mesh);
+	// Lets the render thread put up a placeholder while the passes below are still running.
+	if (!mesh.parts.empty()) {
+		load.boundsMin = mesh.boundsMin;
+		load.boundsMax = mesh.boundsMax;
+		load.boundsKnown = true;
+	}
+
+	if (!cached) {
+		MeshOptimizer::VertexReader readPosition = [this](const uint8_t* vertex) { return vertexLayout->decode(vertex, VERTEX_COMPONENT_POSITION); };
+		MeshOptimizer::VertexReader readNormal;
+		if (vertexLayout->find(VERTEX_COMPONENT_NORMAL) >= 0)
+			readNormal = [this](const uint8_t* vertex) { return vertexLayout->decode(vertex, VERTEX_COMPONENT_NORMAL); };
+		MeshOptimizer optimizer(vertexLayout->stride(), readPosition, readNormal);
+		bool optimize = !createInfo || createInfo->optimize;
+		if (optimize) {
+			load.optimization = optimizer.optimize(mesh);
+			load.optimized = true;
+		}
+		if (!createInfo || createInfo->generateLods) {
+			MeshSimplifier simplifier(vertexLayout->stride(), readPosition);
+			simplifier.generateLods(mesh, optimize ? &optimizer : nullptr);
+		}
+		MeshletBuilder meshletBuilder(vertexLayout->stride(), readPosition, readNormal);
+		meshletBuilder.buildMeshlets(mesh);
+		cache.store(mesh);
+	}
+}
+
+void AssimpModel::printStatistics() {
+	// Called on the render thread once loading has finished, the workers only fill in their load records.
+	std::ostringstream report;
+	report << std::fixed << std::setprecision(3);
+	for (auto& load : loads)
+		if (load->finished && load->optimized)
+			report << "Optimized " << load->file.filename
+				<< ": ACMR " << load->optimization.before.acmr() << " -> " << load->optimization.after.acmr()
+				<< ", ATVR " << load->optimization.before.atvr() << " -> " << load->optimization.after.atvr() << "\n";
+	std::cout << report.str();
+}
+
+uint64_t AssimpModel::hashImportSettings(ModelCreateInfo* createInfo) {
+	// Anything that changes the imported vertices has to be part of the cache key.
+	// Vectors are hashed per component, aligned gentypes carry padding bytes.
+	uint64_t hash = hashValue(vertexLayout->hash());
+	hash = hashValue(static_cast<int>(defaultFlags), hash);
+	if (createInfo) {
+		for (int i = 0; i < 3; ++i) {
+			hash = hashValue(createInfo->scale[i], hash);
+			hash = hashValue(createInfo->center[i], hash);
+		}
+		for (int i = 0; i < 2; ++i)
+			hash = hashValue(createInfo->uvscale[i], hash);
+		hash = hashValue(createInfo->optimize, hash);
+		hash = hashValue(createInfo->generateLods, hash);
+	}
+	return hash;
 }
 
-void AssimpModel::loadFromFile(const std::string& filename, ModelCreateInfo* createInfo, int modelIndex) {
+void AssimpModel::importFromFile(const std::string& filename, ModelCreateInfo* createInfo, MeshData& mesh) {
 
 	Assimp::Importer Importer;
 	const aiScene* pScene;
@@ -220,13 +364,14 @@ void AssimpModel::loadFromFile(const std::string& filename, ModelCreateInfo* cre
 		center = createInfo->center;
 	}
 
-	dataOffset[modelIndex] = {};
-
 	// Load meshes
 	for (unsigned int i = 0; i < pScene->mNumMeshes; i++) {
 		const aiMesh* paiMesh = pScene->mMeshes[i];
 
-		dataOffset[modelIndex].vertexCount += pScene->mMeshes[i]->mNumVertices;
+		MeshPart part{};
+		part.vertexBase = static_cast<uint32_t>(mesh.vertexData.size() / vertexLayout->stride());
+		part.vertexCount = paiMesh->mNumVertices;
+		part.indexBase = static_cast<uint32_t>(mesh.indexData.size());
 
 		aiColor3D pColor(0.f, 0.f, 0.f);
 		pScene->mMaterials[paiMesh->mMaterialIndex]->Get(AI_MATKEY_COLOR_DIFFUSE, pColor);
@@ -241,116 +386,170 @@ void AssimpModel::loadFromFile(const std::string& filename, ModelCreateInfo* cre
 			const aiVector3D* pBiTangent = (paiMesh->HasTangentsAndBitangents()) ? &(paiMesh->mBitangents[j]) : &Zero3D;
 
 			for (auto& component : vertexLayout->components) {
-				switch (component) {
+				glm::vec4 value(0.0f);
+				switch (VertexLayout::getSemantic(component)) {
 				case VERTEX_COMPONENT_POSITION:
-					vertexData.push_back(pPos->x * scale.x + center.x);
-					vertexData.push_back(-pPos->y * scale.y + center.y);
-					vertexData.push_back(pPos->z * scale.z + center.z);
+					value = glm::vec4(pPos->x * scale.x + center.x, -pPos->y * scale.y + center.y, pPos->z * scale.z + center.z, 1.0f);
 					break;
 				case VERTEX_COMPONENT_NORMAL:
-					vertexData.push_back(pNormal->x);
-					vertexData.push_back(-pNormal->y);
-					vertexData.push_back(pNormal->z);
+					value = glm::vec4(pNormal->x, -pNormal->y, pNormal->z, 0.0f);
 					break;
 				case VERTEX_COMPONENT_UV:
-					vertexData.push_back(pTexCoord->x * uvscale.s);
-					vertexData.push_back(pTexCoord->y * uvscale.t);
+					value = glm::vec4(pTexCoord->x * uvscale.s, pTexCoord->y * uvscale.t, 0.0f, 0.0f);
 					break;
 				case VERTEX_COMPONENT_COLOR:
-					vertexData.push_back(pColor.r);
-					vertexData.push_back(pColor.g);
-					vertexData.push_back(pColor.b);
+					value = glm::vec4(pColor.r, pColor.g, pColor.b, 1.0f);
 					break;
 				case VERTEX_COMPONENT_TANGENT:
-					vertexData.push_back(pTangent->x);
-					vertexData.push_back(pTangent->y);
-					vertexData.push_back(pTangent->z);
+					value = glm::vec4(pTangent->x, pTangent->y, pTangent->z, 0.0f);
 					break;
 				case VERTEX_COMPONENT_BITANGENT:
-					vertexData.push_back(pBiTangent->x);
-					vertexData.push_back(pBiTangent->y);
-					vertexData.push_back(pBiTangent->z);
-					break;
-				case VERTEX_COMPONENT_DUMMY_FLOAT:
-					vertexData.push_back(0.0f);
+					value = glm::vec4(pBiTangent->x, pBiTangent->y, pBiTangent->z, 0.0f);
 					break;
-				case VERTEX_COMPONENT_DUMMY_VEC4:
-					vertexData.push_back(0.0f);
-					vertexData.push_back(0.0f);
-					vertexData.push_back(0.0f);
-					vertexData.push_back(0.0f);
+				default:
 					break;
 				};
+				VertexLayout::encode(component, value, mesh.vertexData);
 			}
 
-			dim.max.x = fmax(pPos->x, dim.max.x);
-			dim.max.y = fmax(pPos->y, dim.max.y);
-			dim.max.z = fmax(pPos->z, dim.max.z);
-
-			dim.min.x = fmin(pPos->x, dim.min.x);
-			dim.min.y = fmin(pPos->y, dim.min.y);
-			dim.min.z = fmin(pPos->z, dim.min.z);
+			// Bounds are taken in model space, after scale, centre and the y flip.
+			glm::vec3 position(pPos->x * scale.x + center.x, -pPos->y * scale.y + center.y, pPos->z * scale.z + center.z);
+			mesh.boundsMax = glm::max(mesh.boundsMax, position);
+			mesh.boundsMin = glm::min(mesh.boundsMin, position);
 		}
 
-		dim.size = dim.max - dim.min;
-
-		uint32_t indexBase = static_cast<uint32_t>(indexData.size());
+		// Face indices are local to the aiMesh, so they are offset by the vertices of the meshes before it.
 		for (unsigned int j = 0; j < paiMesh->mNumFaces; j++) {
 			const aiFace& Face = paiMesh->mFaces[j];
 			if (Face.mNumIndices != 3)
 				continue;
-			indexData.push_back(indexBase + Face.mIndices[0]);
-			indexData.push_back(indexBase + Face.mIndices[1]);
-			indexData.push_back(indexBase + Face.mIndices[2]);
-			dataOffset[modelIndex].indexCount += 3;
+			mesh.indexData.push_back(part.vertexBase + Face.mIndices[0]);
+			mesh.indexData.push_back(part.vertexBase + Face.mIndices[1]);
+			mesh.indexData.push_back(part.vertexBase + Face.mIndices[2]);
+			part.indexCount += 3;
 		}
+		part.lodCount = 1;
+		part.lods[0] = { part.indexBase, part.indexCount, 0.0f };
+		mesh.parts.push_back(part);
 	}
+}
 
-	if (modelIndex == 0) {
-		dataOffset[modelIndex].indexBase = 0;
-		dataOffset[modelIndex].vertexBase = 0;
-	}
-	else {
-		dataOffset[modelIndex].indexBase = dataOffset[modelIndex - 1].indexBase + dataOffset[modelIndex - 1].indexCount;
-		dataOffset[modelIndex].vertexBase = dataOffset[modelIndex - 1].vertexBase + dataOffset[modelIndex - 1].vertexCount;
+void AssimpModel::createPlaceholder(glm::vec3 boundsMin, glm::vec3 boundsMax, DataOffset& offset) {
+	// A box with a flat normal per face, wound like the imported meshes so back faces are culled.
+	std::vector<uint8_t> vertexData;
+	std::vector<uint16_t> indexData;
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+	for (int axis = 0; axis < 3; ++axis) {
+		for (float side : { -1.0f, 1.0f }) {
+			glm::vec3 normal(0.0f), u(0.0f), v(0.0f);
+			normal[axis] = side;
+			u[(axis + 1) % 3] = extent[(axis + 1) % 3];
+			v[(axis + 2) % 3] = extent[(axis + 2) % 3];
+			glm::vec3 faceCenter = center + normal * extent[axis];
+			glm::vec3 corners[4] = { faceCenter - u - v, faceCenter + u - v, faceCenter + u + v, faceCenter - u + v };
+
+			uint32_t base = static_cast<uint32_t>(vertexData.size() / vertexLayout->stride());
+			for (auto& corner : corners) {
+				for (auto& component : vertexLayout->components) {
+					glm::vec4 value(0.0f);
+					switch (VertexLayout::getSemantic(component)) {
+					case VERTEX_COMPONENT_POSITION:
+						value = glm::vec4(corner, 1.0f);
+						break;
+					case VERTEX_COMPONENT_NORMAL:
+						value = glm::vec4(normal, 0.0f);
+						break;
+					case VERTEX_COMPONENT_COLOR:
+						value = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+						break;
+					default:
+						break;
+					}
+					VertexLayout::encode(component, value, vertexData);
+				}
+			}
+			// u x v points along +axis, so the negative side is wound the other way round.
+			uint32_t quad[6] = { 0, 1, 2, 0, 2, 3 };
+			if (side < 0.0f) {
+				std::swap(quad[1], quad[2]);
+				std::swap(quad[4], quad[5]);
+			}
+			for (uint32_t corner : quad)
+				indexData.push_back(static_cast<uint16_t>(base + corner));
+		}
 	}
-}
 
-void AssimpModel::createIndexBuffer() {
-	uint32_t iBufferSize = static_cast<uint32_t>(indexData.size()) * sizeof(uint32_t);
+	PartOffset part{};
+	part.vertexBase = 0;
+	part.indexType = VK_INDEX_TYPE_UINT16;
+	part.lods[0] = { 0, static_cast<uint32_t>(indexData.size()), 0.0f, 0, 0 };
+
+	offset = DataOffset();
+	offset.geometry = geometryPool->add(vertexData, indexData, {});
+	offset.vertexCount = static_cast<uint32_t>(vertexData.size() / vertexLayout->stride());
+	offset.partBase = static_cast<uint32_t>(partOffsets.size());
+	offset.partCount = 1;
+	offset.lodCount = 1;
+	offset.lodErrors[0] = 0.0f;
+	offset.boundingSphere = glm::vec4(center, glm::length(extent));
+	partOffsets.push_back(part);
+}
 
-	Buffer* stagingBuffer = new Buffer(device,
-		iBufferSize,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	stagingBuffer->copyDataToBuffer(indexData.data());
+void AssimpModel::appendMesh(const MeshData& mesh, DataOffset& offset) {
+	// Every file has its own pool allocation. Each part's indices are rebased to its first vertex, which the
+	// draw supplies as vertex offset, so parts of up to 65536 vertices are stored in the 16-bit region.
+	offset = DataOffset();
+	offset.vertexCount = static_cast<uint32_t>(mesh.vertexData.size() / vertexLayout->stride());
+	offset.partBase = static_cast<uint32_t>(partOffsets.size());
+	offset.partCount = static_cast<uint32_t>(mesh.parts.size());
+
+	offset.lodCount = mesh.parts.empty() ? 1 : MESH_MAX_LODS;
+	for (auto& part : mesh.parts)
+		offset.lodCount = std::min(offset.lodCount, part.lodCount);
+	for (uint32_t lod = 0; lod < MESH_MAX_LODS; ++lod)
+		offset.lodErrors[lod] = 0.0f;
+
+	std::vector<uint16_t> indexData16;
+	std::vector<uint32_t> indexData32;
+	for (auto& part : mesh.parts) {
+		PartOffset partOffset{};
+		partOffset.vertexBase = part.vertexBase;
+		bool narrow = part.vertexCount <= 65536;
+		partOffset.indexType = narrow ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+		for (uint32_t lod = 0; lod < offset.lodCount; ++lod) {
+			const MeshLod& source = part.lods[lod];
+			MeshLod& range = partOffset.lods[lod];
+			range.indexBase = static_cast<uint32_t>(narrow ? indexData16.size() : indexData32.size());
+			range.indexCount = source.indexCount;
+			range.error = source.error;
+			range.meshletBase = static_cast<uint32_t>(meshlets.size());
+			range.meshletCount = source.meshletCount;
+			offset.lodErrors[lod] = std::max(offset.lodErrors[lod], source.error);
+
+			for (uint32_t i = 0; i < source.indexCount; ++i) {
+				uint32_t index = mesh.indexData[source.indexBase + i] - part.vertexBase;
+				if (narrow)
+					indexData16.push_back(static_cast<uint16_t>(index));
+				else
+					indexData32.push_back(index);
+			}
+			// Meshlets partition the level's range and are kept relative to its start, so the pool can move it.
+			for (uint32_t m = 0; m < source.meshletCount; ++m) {
+				Meshlet meshlet = mesh.meshlets[source.meshletBase + m];
+				meshlet.indexBase -= source.indexBase;
+				meshlets.push_back(meshlet);
+			}
+		}
+		partOffsets.push_back(partOffset);
+	}
+	offset.geometry = geometryPool->add(mesh.vertexData, indexData16, indexData32);
 
-	indexBuffer = new Buffer(device,
-		iBufferSize,
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	indexBuffer->copyBufferToBuffer(stagingBuffer, commandPool);
+	glm::vec3 sphereCenter = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+	offset.boundingSphere = glm::vec4(sphereCenter, mesh.parts.empty() ? 0.0f : glm::length(mesh.boundsMax - sphereCenter));
 
-	delete stagingBuffer;
-	indexData.resize(0);
+	dim.min = glm::min(dim.min, mesh.boundsMin);
+	dim.max = glm::max(dim.max, mesh.boundsMax);
+	dim.size = dim.max - dim.min;
 }
-
-void AssimpModel::createVertexBuffer() {
-	uint32_t vBufferSize = static_cast<uint32_t>(vertexData.size()) * sizeof(float);
-	uint32_t iBufferSize = static_cast<uint32_t>(indexData.size()) * sizeof(uint32_t);
-
-	Buffer* stagingBuffer = new Buffer(device,
-		vBufferSize,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	stagingBuffer->copyDataToBuffer(vertexData.data());
-
-	vertexBuffer = new Buffer(device,
-		vBufferSize,
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	vertexBuffer->copyBufferToBuffer(stagingBuffer, commandPool);
-
-	delete stagingBuffer;
-	vertexData.resize(0);
-}
\ No newline at end of file
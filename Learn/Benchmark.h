@@ -0,0 +1,237 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "LogicalDevice.h"
+#include "Camera.h"
+
+struct BenchmarkSettings {
+	bool enable = false;
+	uint32_t frameCount = 1000;
+	uint32_t warmupFrames = 30;
+	uint32_t width = 800;
+	uint32_t height = 600;
+	std::string outputPath;
+	// Teapot copies added to the scene, also without --benchmark
+	uint32_t instanceCount = 0;
+	// Lay down depth with a position-only pass first, so the shading pass runs each pixel's fragment shader once
+	bool depthPrepass = false;
+};
+
+class Benchmark {
+public:
+	~Benchmark();
+	Benchmark(LogicalDevice* device, BenchmarkSettings settings, uint32_t slotCount);
+	VkQueryPool getQueryPool() { return queryPool; }
+	uint32_t getFrameIndex() { return frameIndex; }
+	bool isFinished() { return frameIndex >= settings.warmupFrames + settings.frameCount; }
+
+	void updateCamera(Camera* camera);
+	void beginCpuWork();
+	void endCpuWork();
+	void endFrame();
+	void recordCulledTriangles(uint64_t count);
+	void recordStateChanges(uint64_t count, uint64_t avoidedCount);
+	void markGpuSlot(uint32_t slot);
+	void collectGpuTime(uint32_t slot);
+	void collectAllGpuTimes();
+	void writeReport(VkExtent2D extent);
+
+private:
+	void createQueryPool();
+	bool isMeasuring() { return frameIndex >= settings.warmupFrames; }
+	std::string statisticsToJson(std::vector<double> samples);
+	static double percentile(const std::vector<double>& sorted, double p);
+
+	LogicalDevice* device;
+	BenchmarkSettings settings;
+	uint32_t slotCount;
+	uint32_t frameIndex = 0;
+
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	float timestampPeriod = 1.0f;
+	std::vector<int64_t> slotFrames;
+
+	glm::vec3 orbitCenter = glm::vec3(0.0f);
+	float orbitRadius = 0.0f;
+	float orbitHeight = 0.0f;
+	float orbitStartAngle = 0.0f;
+	bool orbitInitialized = false;
+
+	std::chrono::time_point<std::chrono::steady_clock> cpuWorkStart;
+	std::chrono::time_point<std::chrono::steady_clock> lastFrameEnd;
+	std::vector<double> cpuTimes;
+	std::vector<double> frameTimes;
+	std::vector<double> gpuTimes;
+	std::vector<double> culledTriangles;
+	std::vector<double> stateChanges;
+	std::vector<double> stateChangesAvoided;
+};
+
+Benchmark::~Benchmark() {
+	if (queryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(device->getDevice(), queryPool, nullptr);
+}
+
+Benchmark::Benchmark(LogicalDevice* inDevice, BenchmarkSettings inSettings, uint32_t inSlotCount) {
+	device = inDevice;
+	settings = inSettings;
+	slotCount = inSlotCount;
+	slotFrames.resize(slotCount, -1);
+	cpuTimes.reserve(settings.frameCount);
+	frameTimes.reserve(settings.frameCount);
+	gpuTimes.reserve(settings.frameCount);
+	culledTriangles.reserve(settings.frameCount);
+	stateChanges.reserve(settings.frameCount);
+	stateChangesAvoided.reserve(settings.frameCount);
+	createQueryPool();
+	lastFrameEnd = std::chrono::steady_clock::now();
+}
+
+void Benchmark::createQueryPool() {
+	VkPhysicalDeviceLimits& limits = device->getPhysicalDevice()->getProperties().limits;
+	if (!limits.timestampComputeAndGraphics) {
+		std::cerr << "Timestamp queries are not supported, GPU times will not be reported.\n";
+		return;
+	}
+	timestampPeriod = limits.timestampPeriod;
+
+	// Two timestamps per slot: top and bottom of the recorded frame.
+	VkQueryPoolCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	createInfo.queryCount = 2 * slotCount;
+
+	if (vkCreateQueryPool(device->getDevice(), &createInfo, nullptr, &queryPool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create timestamp query pool.");
+}
+
+void Benchmark::updateCamera(Camera* camera) {
+	// The path only depends on the frame index so every run sees the same sequence of views.
+	if (!orbitInitialized) {
+		orbitRadius = std::sqrt(camera->position.x * camera->position.x + camera->position.y * camera->position.y);
+		orbitHeight = camera->position.z;
+		orbitStartAngle = std::atan2(camera->position.y, camera->position.x);
+		orbitInitialized = true;
+	}
+
+	uint32_t totalFrames = settings.warmupFrames + settings.frameCount;
+	float angle = orbitStartAngle + 2.0f * 3.14159265f * frameIndex / static_cast<float>(totalFrames);
+	glm::vec3 position(orbitRadius * std::cos(angle), orbitRadius * std::sin(angle), orbitHeight);
+	camera->setLookAt(position, orbitCenter);
+}
+
+void Benchmark::beginCpuWork() {
+	cpuWorkStart = std::chrono::steady_clock::now();
+}
+
+void Benchmark::endCpuWork() {
+	if (!isMeasuring())
+		return;
+	auto now = std::chrono::steady_clock::now();
+	cpuTimes.push_back(std::chrono::duration<double, std::milli>(now - cpuWorkStart).count());
+}
+
+void Benchmark::endFrame() {
+	auto now = std::chrono::steady_clock::now();
+	if (isMeasuring())
+		frameTimes.push_back(std::chrono::duration<double, std::milli>(now - lastFrameEnd).count());
+	lastFrameEnd = now;
+	frameIndex++;
+}
+
+void Benchmark::recordCulledTriangles(uint64_t count) {
+	if (isMeasuring())
+		culledTriangles.push_back(static_cast<double>(count));
+}
+
+void Benchmark::recordStateChanges(uint64_t count, uint64_t avoidedCount) {
+	if (!isMeasuring())
+		return;
+	stateChanges.push_back(static_cast<double>(count));
+	stateChangesAvoided.push_back(static_cast<double>(avoidedCount));
+}
+
+void Benchmark::markGpuSlot(uint32_t slot) {
+	slotFrames[slot] = frameIndex;
+}
+
+void Benchmark::collectGpuTime(uint32_t slot) {
+	// Only valid once the fence of the submission that wrote this slot has signaled.
+	if (queryPool == VK_NULL_HANDLE || slotFrames[slot] < 0)
+		return;
+
+	uint64_t timestamps[2];
+	VkResult result = vkGetQueryPoolResults(device->getDevice(), queryPool, 2 * slot, 2, sizeof(timestamps), timestamps,
+		sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("Failed to retrieve timestamp query results.");
+
+	if (slotFrames[slot] >= static_cast<int64_t>(settings.warmupFrames))
+		gpuTimes.push_back((timestamps[1] - timestamps[0]) * timestampPeriod / 1e6);
+	slotFrames[slot] = -1;
+}
+
+void Benchmark::collectAllGpuTimes() {
+	for (uint32_t i = 0; i < slotCount; ++i)
+		collectGpuTime(i);
+}
+
+double Benchmark::percentile(const std::vector<double>& sorted, double p) {
+	if (sorted.empty())
+		return 0.0;
+	size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+	return sorted[std::min(std::max(rank, size_t(1)), sorted.size()) - 1];
+}
+
+std::string Benchmark::statisticsToJson(std::vector<double> samples) {
+	std::sort(samples.begin(), samples.end());
+	double sum = 0.0;
+	for (double sample : samples)
+		sum += sample;
+
+	std::ostringstream json;
+	json << std::fixed << std::setprecision(4);
+	json << "{ \"samples\": " << samples.size()
+		<< ", \"mean\": " << (samples.empty() ? 0.0 : sum / samples.size())
+		<< ", \"min\": " << (samples.empty() ? 0.0 : samples.front())
+		<< ", \"p50\": " << percentile(samples, 0.50)
+		<< ", \"p95\": " << percentile(samples, 0.95)
+		<< ", \"p99\": " << percentile(samples, 0.99)
+		<< ", \"max\": " << (samples.empty() ? 0.0 : samples.back()) << " }";
+	return json.str();
+}
+
+void Benchmark::writeReport(VkExtent2D extent) {
+	std::ostringstream json;
+	json << "{\n"
+		<< "\t\"device\": \"" << device->getPhysicalDevice()->getProperties().deviceName << "\",\n"
+		<< "\t\"width\": " << extent.width << ",\n"
+		<< "\t\"height\": " << extent.height << ",\n"
+		<< "\t\"frames\": " << settings.frameCount << ",\n"
+		<< "\t\"warmupFrames\": " << settings.warmupFrames << ",\n"
+		<< "\t\"frameMs\": " << statisticsToJson(frameTimes) << ",\n"
+		<< "\t\"cpuMs\": " << statisticsToJson(cpuTimes) << ",\n"
+		<< "\t\"gpuMs\": " << (queryPool != VK_NULL_HANDLE ? statisticsToJson(gpuTimes) : "null") << ",\n"
+		<< "\t\"culledTriangles\": " << statisticsToJson(culledTriangles) << ",\n"
+		<< "\t\"stateChanges\": " << statisticsToJson(stateChanges) << ",\n"
+		<< "\t\"stateChangesAvoided\": " << statisticsToJson(stateChangesAvoided) << "\n"
+		<< "}\n";
+
+	if (settings.outputPath.empty()) {
+		std::cout << json.str();
+		return;
+	}
+
+	std::ofstream file(settings.outputPath);
+	if (!file.is_open())
+		throw std::runtime_error("Failed to open benchmark output file.");
+	file << json.str();
+	std::cout << "Benchmark results written to " << settings.outputPath << "\n";
+}
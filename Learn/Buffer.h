@@ -1,18 +1,25 @@
 #pragma once
 
+#include <cstring>
+#include <vector>
 #include "LogicalDevice.h"
+#include "MemoryAllocator.h"
 #include "CommandPool.h"
 #include "CommandBuffer.h"
 
 class Buffer {
 public:
 	~Buffer();
-	Buffer(LogicalDevice* device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+	Buffer(LogicalDevice* device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+		const std::vector<uint32_t>& sharingFamilies = {});
 	VkBuffer& getBuffer() { return buffer; }
-	VkDeviceMemory& getMemory() { return memory; }
+	/** @brief Whether the queue families it was created for all access it without ownership transfers */
+	bool isConcurrent() { return sharingFamilies.size() > 1; }
+	MemoryAllocation& getAllocation() { return allocation; }
+	void* getMappedData() { return allocation.mapped; }
 	void copyDataToBuffer(void *data);
 	void copyDataToBufferFlush(void* data);
-	void copyBufferToBuffer(Buffer* srcBuffer, CommandPool* commandPool);
+	void copyBufferToBuffer(Buffer* srcBuffer, VkCommandBuffer commandBuffer, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0, VkDeviceSize copySize = 0);
 
 private:
 	void createBuffer();
@@ -23,21 +30,24 @@ private:
 	VkDeviceSize size;
 	VkBufferUsageFlags usage;
 	VkMemoryPropertyFlags properties;
+	std::vector<uint32_t> sharingFamilies;
 
 	VkBuffer buffer;
-	VkDeviceMemory memory;
+	MemoryAllocation allocation;
 };
 
 Buffer::~Buffer() {
 	vkDestroyBuffer(device->getDevice(), buffer, nullptr);
-	vkFreeMemory(device->getDevice(), memory, nullptr);
+	device->getAllocator()->free(allocation);
 }
 
-Buffer::Buffer(LogicalDevice* inDevice, VkDeviceSize inSize, VkBufferUsageFlags inUsage, VkMemoryPropertyFlags inProperties) {
+Buffer::Buffer(LogicalDevice* inDevice, VkDeviceSize inSize, VkBufferUsageFlags inUsage, VkMemoryPropertyFlags inProperties,
+	const std::vector<uint32_t>& inSharingFamilies) {
 	device = inDevice;
 	size = inSize;
 	usage = inUsage;
 	properties = inProperties;
+	sharingFamilies = inSharingFamilies;
 	createBuffer();
 	allocateMemory();
 	bindMemory();
@@ -48,7 +58,15 @@ void Buffer::createBuffer() {
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferInfo.size = size;
 	bufferInfo.usage = usage;
-	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	// Buffers written on one queue and read on another for their whole life are shared instead of handed over.
+	if (isConcurrent()) {
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharingFamilies.size());
+		bufferInfo.pQueueFamilyIndices = sharingFamilies.data();
+	}
+	else {
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
 
 	if (vkCreateBuffer(device->getDevice(), &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
 		throw std::runtime_error("Failed to create buffer.");
@@ -58,49 +76,28 @@ void Buffer::allocateMemory() {
 	VkMemoryRequirements memRequirements;
 	vkGetBufferMemoryRequirements(device->getDevice(), buffer, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = device->getPhysicalDevice()->retrieveMemoryTypeIndex(memRequirements.memoryTypeBits, properties);
-
-	if (vkAllocateMemory(device->getDevice(), &allocInfo, nullptr, &memory) != VK_SUCCESS)
-		throw std::runtime_error("Failed to allocate memory.");
+	allocation = device->getAllocator()->allocate(memRequirements, properties, MEMORY_POOL_LINEAR);
 }
 
 void Buffer::bindMemory() {
-	vkBindBufferMemory(device->getDevice(), buffer, memory, 0);
+	vkBindBufferMemory(device->getDevice(), buffer, allocation.memory, allocation.offset);
 }
 
 void Buffer::copyDataToBuffer(void *src) {
-	void* data;
-	vkMapMemory(device->getDevice(), memory, 0, size, 0, &data);
-	memcpy(data, src, static_cast<size_t>(size));
-	vkUnmapMemory(device->getDevice(), memory);
+	if (allocation.mapped == nullptr)
+		throw std::runtime_error("Failed to copy data to buffer that is not host visible.");
+	memcpy(allocation.mapped, src, static_cast<size_t>(size));
 }
 
 void Buffer::copyDataToBufferFlush(void* src) {
-	void* data;
-	vkMapMemory(device->getDevice(), memory, 0, size, 0, &data);
-	memcpy(data, src, static_cast<size_t>(size));
-	
-	VkMappedMemoryRange range{};
-	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-	range.memory = memory;
-	range.offset = 0;
-	range.size = size;
-	vkFlushMappedMemoryRanges(device->getDevice(), 1, &range);
-	vkUnmapMemory(device->getDevice(), memory);
+	copyDataToBuffer(src);
+	device->getAllocator()->flush(allocation, 0, size);
 }
 
-void Buffer::copyBufferToBuffer(Buffer* srcBuffer, CommandPool* commandPool) {
-	CommandBuffer commandBuffer(device, commandPool);
-	commandBuffer.beginSingalTimeCommands();
-
+void Buffer::copyBufferToBuffer(Buffer* srcBuffer, VkCommandBuffer commandBuffer, VkDeviceSize srcOffset, VkDeviceSize dstOffset, VkDeviceSize copySize) {
 	VkBufferCopy region{};
-	region.srcOffset = 0;
-	region.dstOffset = 0;
-	region.size = size;
-	vkCmdCopyBuffer(commandBuffer.getCommandBuffer(), srcBuffer->getBuffer(), buffer, 1, &region);
-
-	commandBuffer.endSingalTimeCommands();
+	region.srcOffset = srcOffset;
+	region.dstOffset = dstOffset;
+	region.size = copySize == 0 ? size - dstOffset : copySize;
+	vkCmdCopyBuffer(commandBuffer, srcBuffer->getBuffer(), buffer, 1, &region);
 }
\ No newline at end of file
@@ -64,6 +64,13 @@ public:
 		return glm::lookAt(position, position + front, up);
 	}
 
+	void setLookAt(glm::vec3 inPos, glm::vec3 target) {
+		position = inPos;
+		front = glm::normalize(target - inPos);
+		right = glm::normalize(glm::cross(front, worldUp));
+		up = glm::normalize(glm::cross(right, front));
+	}
+
 	void processKeyboard(CameraMovement direction, float deltaTime) {
 		float velocity = movementSpeed * deltaTime;
 		if (direction == CAM_FORWARD)
@@ -6,11 +6,11 @@
 class CommandBuffer {
 public:
 	~CommandBuffer();
-	CommandBuffer(LogicalDevice* device, CommandPool* commandPool);
+	CommandBuffer(LogicalDevice* device, CommandPool* commandPool, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 	VkCommandBuffer& getCommandBuffer() { return commandBuffer; }
 	void beginSingalTimeCommands();
-	void endSingalTimeCommands();
 	void beginCommands();
+	void beginSecondaryCommands(VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer);
 	void endCommands();
 
 private:
@@ -20,6 +20,7 @@ private:
 
 	LogicalDevice* device;
 	CommandPool* commandPool;
+	VkCommandBufferLevel level;
 	VkCommandBuffer commandBuffer;
 };
 
@@ -27,9 +28,10 @@ CommandBuffer::~CommandBuffer() {
 	vkFreeCommandBuffers(device->getDevice(), commandPool->getCommandPool(), 1, &commandBuffer);
 }
 
-CommandBuffer::CommandBuffer(LogicalDevice* inDevice, CommandPool* inCommandPool) {
+CommandBuffer::CommandBuffer(LogicalDevice* inDevice, CommandPool* inCommandPool, VkCommandBufferLevel inLevel) {
 	device = inDevice;
 	commandPool = inCommandPool;
+	level = inLevel;
 	allocateCommandBuffer();
 }
 
@@ -42,7 +44,7 @@ void CommandBuffer::allocateCommandBuffer() {
 
 void CommandBuffer::setupCommandBufferAllocateInfo(VkCommandBufferAllocateInfo& allocateInfo) {
 	allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocateInfo.level = level;
 	allocateInfo.commandPool = commandPool->getCommandPool();
 	allocateInfo.commandBufferCount = 1;
 }
@@ -62,19 +64,6 @@ void CommandBuffer::beginSingalTimeCommands() {
 		throw std::runtime_error("Failed to begin command buffer.");
 }
 
-void CommandBuffer::endSingalTimeCommands() {
-	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
-		throw std::runtime_error("Failed to end recording command buffer.");
-
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
-
-	vkQueueSubmit(device->getGraphicQueue(), 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(device->getGraphicQueue());
-}
-
 void CommandBuffer::beginCommands() {
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -85,6 +74,22 @@ void CommandBuffer::beginCommands() {
 		throw std::runtime_error("Failed to begin command buffer.");
 }
 
+void CommandBuffer::beginSecondaryCommands(VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer) {
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = renderPass;
+	inheritanceInfo.subpass = subpass;
+	inheritanceInfo.framebuffer = framebuffer;
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		throw std::runtime_error("Failed to begin secondary command buffer.");
+}
+
 void CommandBuffer::endCommands() {
 	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
 		throw std::runtime_error("Failed to end recording command buffer.");
@@ -5,8 +5,10 @@
 class CommandPool {
 public:
 	~CommandPool();
-	CommandPool(LogicalDevice* device);
+	CommandPool(LogicalDevice* device, VkCommandPoolCreateFlags flags = 0);
+	CommandPool(LogicalDevice* device, uint32_t queueFamilyIndex, VkCommandPoolCreateFlags flags);
 	VkCommandPool& getCommandPool() { return commandPool; }
+	void reset();
 
 private:
 	LogicalDevice* device;
@@ -17,13 +19,22 @@ CommandPool::~CommandPool() {
 	vkDestroyCommandPool(device->getDevice(), commandPool, nullptr);
 }
 
-CommandPool::CommandPool(LogicalDevice* inDevice) {
+CommandPool::CommandPool(LogicalDevice* inDevice, VkCommandPoolCreateFlags flags) :
+	CommandPool(inDevice, inDevice->getPhysicalDevice()->getGraphicQueueIndex(), flags) {
+}
+
+CommandPool::CommandPool(LogicalDevice* inDevice, uint32_t queueFamilyIndex, VkCommandPoolCreateFlags flags) {
 	device = inDevice;
 	VkCommandPoolCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	createInfo.queueFamilyIndex = device->getPhysicalDevice()->getQueueFamilyIndices().graphic.value();
-	createInfo.flags = 0;
+	createInfo.queueFamilyIndex = queueFamilyIndex;
+	createInfo.flags = flags;
 
 	if (vkCreateCommandPool(device->getDevice(), &createInfo, nullptr, &commandPool) != VK_SUCCESS)
 		throw std::runtime_error("Failed to create command pool.");
+}
+
+void CommandPool::reset() {
+	if (vkResetCommandPool(device->getDevice(), commandPool, 0) != VK_SUCCESS)
+		throw std::runtime_error("Failed to reset command pool.");
 }
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+
+// Holds objects retired while earlier frames may still reference them.
+// Each deleter is stamped with the number of frames submitted when it was retired
+// and runs once frameLatency further frames have been submitted and their fences waited on.
+class DeletionQueue {
+public:
+	~DeletionQueue();
+	DeletionQueue(uint32_t frameLatency);
+	void push(std::function<void()> deleter);
+	void collect();
+	void endFrame() { frame++; }
+	void flush();
+
+private:
+	struct Entry {
+		uint64_t frame;
+		std::function<void()> deleter;
+	};
+
+	uint32_t frameLatency;
+	uint64_t frame = 0;
+	std::deque<Entry> entries;
+};
+
+DeletionQueue::~DeletionQueue() {
+	flush();
+}
+
+DeletionQueue::DeletionQueue(uint32_t inFrameLatency) {
+	frameLatency = inFrameLatency;
+}
+
+void DeletionQueue::push(std::function<void()> deleter) {
+	entries.push_back({ frame, std::move(deleter) });
+}
+
+void DeletionQueue::collect() {
+	// Called right after the fence wait of the next frame slot, when every frame up to frame - frameLatency has finished.
+	while (!entries.empty() && entries.front().frame + frameLatency <= frame) {
+		entries.front().deleter();
+		entries.pop_front();
+	}
+}
+
+void DeletionQueue::flush() {
+	// Only valid once the device is idle.
+	for (auto& entry : entries)
+		entry.deleter();
+	entries.clear();
+}
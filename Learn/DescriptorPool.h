@@ -1,18 +1,18 @@
 #pragma once
 
-#include "SwapChain.h"
+#include "LogicalDevice.h"
 
 class DescriptorPool {
 public:
 	~DescriptorPool();
-	DescriptorPool(LogicalDevice* device, SwapChain* swapChain);
+	DescriptorPool(LogicalDevice* device, uint32_t setCount);
 	VkDescriptorPool& getPool() { return pool; }
-	SwapChain* getSwapChainRef() { return swapChain; }
+	uint32_t getSetCount() { return setCount; }
 
 private:
 	void createDescriptorPool();
 	LogicalDevice* device;
-	SwapChain* swapChain;
+	uint32_t setCount;
 	VkDescriptorPool pool;
 };
 
@@ -20,26 +20,26 @@ DescriptorPool::~DescriptorPool() {
 	vkDestroyDescriptorPool(device->getDevice(), pool, nullptr);
 }
 
-DescriptorPool::DescriptorPool(LogicalDevice* inDevice, SwapChain* inSwapChain) {
+DescriptorPool::DescriptorPool(LogicalDevice* inDevice, uint32_t inSetCount) {
 	device = inDevice;
-	swapChain = inSwapChain;
+	setCount = inSetCount;
 	createDescriptorPool();
 }
 
 void DescriptorPool::createDescriptorPool() {
 	std::array<VkDescriptorPoolSize, 2> poolSizes;
 	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSizes[0].descriptorCount = static_cast<uint32_t>(swapChain->getImageCount());
-	poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-	poolSizes[1].descriptorCount = static_cast<uint32_t>(swapChain->getImageCount());
+	poolSizes[0].descriptorCount = setCount;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = 2 * setCount;
 	// poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	// poolSizes[1].descriptorCount = static_cast<uint32_t>(swapChain->getImageCount());
+	// poolSizes[1].descriptorCount = setCount;
 
 	VkDescriptorPoolCreateInfo poolInfo = {};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	poolInfo.pPoolSizes = poolSizes.data();
-	poolInfo.maxSets = static_cast<uint32_t>(swapChain->getImageCount());
+	poolInfo.maxSets = setCount;
 
 	if (vkCreateDescriptorPool(device->getDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
 		throw std::runtime_error("Failed to create descriptor pool");
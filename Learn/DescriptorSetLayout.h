@@ -33,12 +33,21 @@ void DescriptorSetLayout::createDescriptorSetLayout() {
 	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	uboLayoutBinding.pImmutableSamplers = nullptr;
 	
-	VkDescriptorSetLayoutBinding dynamicUboLayoutBinding{};
-	dynamicUboLayoutBinding.binding = 1;
-	dynamicUboLayoutBinding.descriptorCount = 1;
-	dynamicUboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-	dynamicUboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-	dynamicUboLayoutBinding.pImmutableSamplers = nullptr;
+	// Every object of the frame, and the object index of every instance drawn. Draws select theirs
+	// through gl_InstanceIndex, so the set is bound once.
+	VkDescriptorSetLayoutBinding objectLayoutBinding{};
+	objectLayoutBinding.binding = 1;
+	objectLayoutBinding.descriptorCount = 1;
+	objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	objectLayoutBinding.pImmutableSamplers = nullptr;
+
+	VkDescriptorSetLayoutBinding instanceLayoutBinding{};
+	instanceLayoutBinding.binding = 2;
+	instanceLayoutBinding.descriptorCount = 1;
+	instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	instanceLayoutBinding.pImmutableSamplers = nullptr;
 	
 	/*
 	VkDescriptorSetLayoutBinding samplerLayoutBinding{};
@@ -51,7 +60,7 @@ void DescriptorSetLayout::createDescriptorSetLayout() {
 	std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
 	*/
 
-	std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, dynamicUboLayoutBinding };
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings = { uboLayoutBinding, objectLayoutBinding, instanceLayoutBinding };
 
 	VkDescriptorSetLayoutCreateInfo layoutInfo{};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -3,15 +3,17 @@
 #include <array>
 #include "DescriptorSetLayout.h"
 #include "UniformBuffers.h"
+#include "ObjectBuffer.h"
 #include "Texture.h"
 
 class DescriptorSets {
 public:
 	~DescriptorSets() {};
 	DescriptorSets(LogicalDevice* logicalDevice, DescriptorSetLayout* layout, 
-		DescriptorPool* descriptorPool, UniformBuffers* uniformBuffers, Texture* texture);
+		DescriptorPool* descriptorPool, UniformBuffers* uniformBuffers, ObjectBuffer* objectBuffer, Texture* texture);
 	VkDescriptorSetLayout& getLayout() { return layout->getLayout(); }
 	VkDescriptorSet& getDescriptorSet(size_t index) { return descriptorSets[index]; }
+	void updateObjectBuffer(size_t index);
 
 private:
 	void createDescriptorSets();
@@ -20,29 +22,33 @@ private:
 	DescriptorSetLayout* layout;
 	DescriptorPool* pool;
 	UniformBuffers* uniformBuffer;
+	ObjectBuffer* objectBuffer;
 	Texture* texture;
 
 	std::vector<VkDescriptorSet> descriptorSets;
+	// Object buffer each set points at, the buffer is replaced when it grows
+	std::vector<Buffer*> boundObjectBuffers;
 };
 
 DescriptorSets::DescriptorSets(LogicalDevice* inDevice, DescriptorSetLayout* inLayout,
-	DescriptorPool* inDescriptorPool, UniformBuffers* inUniformBuffers, Texture* inTexture) {
+	DescriptorPool* inDescriptorPool, UniformBuffers* inUniformBuffers, ObjectBuffer* inObjectBuffer, Texture* inTexture) {
 	device = inDevice;
 	layout = inLayout;
 	pool = inDescriptorPool;
 	uniformBuffer = inUniformBuffers;
+	objectBuffer = inObjectBuffer;
 	texture = inTexture;
 
 	createDescriptorSets();
 }
 
 void DescriptorSets::createDescriptorSets() {
-	std::vector<VkDescriptorSetLayout> layouts(pool->getSwapChainRef()->getImageCount(), layout->getLayout());
+	std::vector<VkDescriptorSetLayout> layouts(pool->getSetCount(), layout->getLayout());
 
 	VkDescriptorSetAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	allocInfo.descriptorPool = pool->getPool();
-	allocInfo.descriptorSetCount = static_cast<uint32_t>(pool->getSwapChainRef()->getImageCount());
+	allocInfo.descriptorSetCount = pool->getSetCount();
 	allocInfo.pSetLayouts = layouts.data();
 
 	descriptorSets.resize(layouts.size());
@@ -51,14 +57,14 @@ void DescriptorSets::createDescriptorSets() {
 
 	for (size_t i = 0; i < layouts.size(); ++i) {
 		VkDescriptorBufferInfo uboBuffer{};
-		uboBuffer.buffer = uniformBuffer->getBufferRef(i)->getBuffer();
-		uboBuffer.offset = 0;
+		uboBuffer.buffer = uniformBuffer->getBufferRef()->getBuffer();
+		uboBuffer.offset = uniformBuffer->getRegionOffset(static_cast<uint32_t>(i));
 		uboBuffer.range = sizeof(UniformBufferObject);
 
-		VkDescriptorBufferInfo dynamicUboBuffer{};
-		dynamicUboBuffer.buffer = uniformBuffer->getDynamicBufferRef(i)->getBuffer();
-		dynamicUboBuffer.offset = 0;
-		dynamicUboBuffer.range = sizeof(DynamicUniformObject);
+		VkDescriptorBufferInfo instanceBuffer{};
+		instanceBuffer.buffer = uniformBuffer->getBufferRef()->getBuffer();
+		instanceBuffer.offset = uniformBuffer->getRegionOffset(static_cast<uint32_t>(i)) + uniformBuffer->getInstanceArrayOffset();
+		instanceBuffer.range = uniformBuffer->getInstanceArraySize();
 		/*
 		VkDescriptorImageInfo imageInfo{};
 		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
@@ -76,12 +82,36 @@ void DescriptorSets::createDescriptorSets() {
 		
 		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrites[1].dstSet = descriptorSets[i];
-		descriptorWrites[1].dstBinding = 1;
+		descriptorWrites[1].dstBinding = 2;
 		descriptorWrites[1].dstArrayElement = 0;
-		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 		descriptorWrites[1].descriptorCount = 1;
-		descriptorWrites[1].pBufferInfo = &dynamicUboBuffer;
+		descriptorWrites[1].pBufferInfo = &instanceBuffer;
 		
 		vkUpdateDescriptorSets(device->getDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 	}
-}
\ No newline at end of file
+	boundObjectBuffers.assign(descriptorSets.size(), nullptr);
+	for (size_t i = 0; i < descriptorSets.size(); ++i)
+		updateObjectBuffer(i);
+}
+
+void DescriptorSets::updateObjectBuffer(size_t index) {
+	// Only called for sets whose frame has finished, sets in use by the GPU must not be written.
+	if (boundObjectBuffers[index] == objectBuffer->getBufferRef())
+		return;
+	VkDescriptorBufferInfo objectBufferInfo{};
+	objectBufferInfo.buffer = objectBuffer->getBufferRef()->getBuffer();
+	objectBufferInfo.offset = 0;
+	objectBufferInfo.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = descriptorSets[index];
+	descriptorWrite.dstBinding = 1;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pBufferInfo = &objectBufferInfo;
+	vkUpdateDescriptorSets(device->getDevice(), 1, &descriptorWrite, 0, nullptr);
+	boundObjectBuffers[index] = objectBuffer->getBufferRef();
+}
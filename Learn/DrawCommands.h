@@ -7,138 +7,348 @@
 #include "RenderPass.h"
 #include "Framebuffers.h"
 #include "Pipeline.h"
-#include "AssimpModel.h"
+#include "GeometryPool.h"
 #include "DescriptorSets.h"
+#include "ThreadPool.h"
 
 
+// One draw of the frame; the list is rebuilt by the application every frame.
+// Its instances are a range of the frame's instance list, which vertex shaders map to object data.
+// Draws of a single object also name it in their constants, so recorded one by one they skip the list.
+struct DrawItem {
+	VkPipeline pipeline;
+	DrawConstants constants;
+	uint32_t firstInstance;
+	uint32_t instanceCount;
+	VkIndexType indexType;
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+};
+
+// Below this many draws per thread the job hand-off costs more than the recording it saves.
+const uint32_t MIN_DRAWS_PER_RECORDING_THREAD = 256;
+const uint32_t MIN_INDIRECT_DRAW_CAPACITY = 1024;
+
+/** @brief State set by the recorded frame, next to what binding it for every draw item would have cost */
+struct DrawStatistics {
+	uint64_t drawItems = 0;
+	uint64_t drawCalls = 0;
+	uint64_t pipelineBinds = 0;
+	uint64_t descriptorSetBinds = 0;
+	uint64_t indexBufferBinds = 0;
+	uint64_t constantPushes = 0;
+	// Binds and pushes left out because the previous draw had set the same state. The descriptor set is
+	// bound once per chunk whatever the order, so it is not counted.
+	uint64_t pipelineBindsSkipped = 0;
+	uint64_t indexBufferBindsSkipped = 0;
+	uint64_t constantPushesSkipped = 0;
+
+	uint64_t getStateChanges() const { return pipelineBinds + descriptorSetBinds + indexBufferBinds + constantPushes; }
+	uint64_t getStateChangesAvoided() const { return pipelineBindsSkipped + indexBufferBindsSkipped + constantPushesSkipped; }
+};
+
+// Re-records the command buffer of a frame in flight every frame.
+// The draw list is split into contiguous chunks, each recorded into a secondary command buffer
+// from a pool owned by that chunk, and the primary only executes them inside the render pass.
+// Pools belong to a single frame slot, so they are reset once that slot's fence has signaled.
+// Nothing here depends on the swap chain image count, so a resize only swaps the render targets.
+// Draws are recorded in list order and state is only set when it differs from the previous draw's,
+// so the list is expected to come sorted by state from the render queue.
+// The draw parameters are written into an indirect buffer of the frame slot, and every run of draws
+// sharing a pipeline and index type is a single vkCmdDrawIndexedIndirect. Devices without multi-draw
+// indirect or a first instance in indirect draws fall back to one direct draw per item.
 class DrawCommands {
 public:
 	~DrawCommands();
-	DrawCommands(LogicalDevice* device, SwapChain* swapChain, CommandPool* commandPool, RenderPass* renderPass, 
-		Framebuffers* framebuffers, UniformBuffers* uniformBuffers, Pipeline* pipeline, AssimpModel* model, DescriptorSets* descriptorSets);
-	CommandBuffer* getCommandBufferRef(uint32_t index) { return commandBuffers[index]; }
+	DrawCommands(LogicalDevice* device, SwapChain* swapChain, RenderPass* renderPass, 
+		Framebuffers* framebuffers, UniformBuffers* uniformBuffers, ObjectBuffer* objectBuffer, Pipeline* pipeline, GeometryPool* geometryPool, DescriptorSets* descriptorSets,
+		ThreadPool* threadPool, uint32_t frameCount, VkQueryPool timestampQueryPool = VK_NULL_HANDLE);
+	CommandBuffer* getCommandBufferRef(uint32_t frameIndex) { return frames[frameIndex].primary; }
+	void setRenderTargets(SwapChain* swapChain, Framebuffers* framebuffers);
+	void setRenderPass(RenderPass* renderPass, Pipeline* pipeline);
+	void recordCommands(uint32_t frameIndex, uint32_t imageIndex, const std::vector<DrawItem>& drawItems);
+	DrawStatistics getStatistics() { return statistics; }
 
 private:
-	void createCommandBuffers();
-	void recordCommands();
+	struct FrameCommands {
+		CommandPool* primaryPool;
+		CommandBuffer* primary;
+		std::vector<CommandPool*> workerPools;
+		std::vector<CommandBuffer*> secondaries;
+		std::vector<DrawStatistics> chunkStatistics;
+		Buffer* indirectBuffer = nullptr;
+		uint32_t indirectCapacity = 0;
+	};
+
+	void createCommandBuffers(uint32_t frameCount);
+	void writeIndirectCommands(FrameCommands& frame, const std::vector<DrawItem>& drawItems);
+	void recordSecondary(uint32_t frameIndex, uint32_t imageIndex, uint32_t chunk, const DrawItem* items, uint32_t first, uint32_t last);
+	void recordPrimary(uint32_t frameIndex, uint32_t imageIndex, uint32_t chunkCount);
 	void setupRenderPassBeginInfo(VkRenderPassBeginInfo& renderPassBeginInfo, std::array<VkClearValue, 2>& clearValues, size_t index);
 
 	LogicalDevice* device;
-	CommandPool* commandPool;
 	SwapChain* swapChain;
 	RenderPass* renderPass;
 	Framebuffers* framebuffers;
 	UniformBuffers* uniformBuffers;
+	ObjectBuffer* objectBuffer;
 	Pipeline* pipeline;
-	AssimpModel* model;
+	GeometryPool* geometryPool;
 	DescriptorSets* descriptorSets;
+	ThreadPool* threadPool;
+	VkQueryPool timestampQueryPool;
 
-	std::vector<CommandBuffer*> commandBuffers;
+	bool multiDrawIndirect;
+	uint32_t maxDrawIndirectCount;
+	uint32_t recorderCount;
+	std::vector<FrameCommands> frames;
+	DrawStatistics statistics;
 };
 
 DrawCommands::~DrawCommands() {
-	for (uint32_t i = 0; i < swapChain->getImageCount(); ++i)
-		delete commandBuffers[i];
+	for (auto& frame : frames) {
+		for (size_t i = 0; i < frame.secondaries.size(); ++i) {
+			delete frame.secondaries[i];
+			delete frame.workerPools[i];
+		}
+		delete frame.primary;
+		delete frame.primaryPool;
+		delete frame.indirectBuffer;
+	}
 }
 
-DrawCommands::DrawCommands(LogicalDevice* inDevice, SwapChain* inSwapChain, CommandPool* inCommandPool, RenderPass* inRenderPass, 
-	Framebuffers* inFramebuffers, UniformBuffers* inUniformBuffers, Pipeline* inPipeline, AssimpModel* inModel, DescriptorSets* inDescriptorSets) {
+DrawCommands::DrawCommands(LogicalDevice* inDevice, SwapChain* inSwapChain, RenderPass* inRenderPass, 
+	Framebuffers* inFramebuffers, UniformBuffers* inUniformBuffers, ObjectBuffer* inObjectBuffer, Pipeline* inPipeline, GeometryPool* inGeometryPool, DescriptorSets* inDescriptorSets,
+	ThreadPool* inThreadPool, uint32_t frameCount, VkQueryPool inTimestampQueryPool) {
 	device = inDevice;
 	swapChain = inSwapChain;
-	commandPool = inCommandPool;
 	renderPass = inRenderPass;
 	framebuffers = inFramebuffers;
 	uniformBuffers = inUniformBuffers;
+	objectBuffer = inObjectBuffer;
 	pipeline = inPipeline;
-	model = inModel;
+	geometryPool = inGeometryPool;
 	descriptorSets = inDescriptorSets;
-	createCommandBuffers();
-	recordCommands();
+	threadPool = inThreadPool;
+	timestampQueryPool = inTimestampQueryPool;
+	// The instance range starts at firstInstance, which indirect draws only honour with drawIndirectFirstInstance.
+	const VkPhysicalDeviceFeatures& features = device->getPhysicalDevice()->getFeatures();
+	multiDrawIndirect = features.multiDrawIndirect && features.drawIndirectFirstInstance;
+	maxDrawIndirectCount = device->getPhysicalDevice()->getProperties().limits.maxDrawIndirectCount;
+	// The calling thread records a chunk as well instead of idling in wait().
+	recorderCount = threadPool->getThreadCount() + 1;
+	createCommandBuffers(frameCount);
+}
+
+void DrawCommands::createCommandBuffers(uint32_t frameCount) {
+	frames.resize(frameCount);
+	for (auto& frame : frames) {
+		frame.primaryPool = new CommandPool(device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		frame.primary = new CommandBuffer(device, frame.primaryPool);
+		frame.workerPools.resize(recorderCount);
+		frame.secondaries.resize(recorderCount);
+		frame.chunkStatistics.resize(recorderCount);
+		for (uint32_t i = 0; i < recorderCount; ++i) {
+			frame.workerPools[i] = new CommandPool(device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+			frame.secondaries[i] = new CommandBuffer(device, frame.workerPools[i], VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+		}
+	}
+}
+
+void DrawCommands::setRenderTargets(SwapChain* inSwapChain, Framebuffers* inFramebuffers) {
+	swapChain = inSwapChain;
+	framebuffers = inFramebuffers;
+}
+
+void DrawCommands::setRenderPass(RenderPass* inRenderPass, Pipeline* inPipeline) {
+	renderPass = inRenderPass;
+	pipeline = inPipeline;
+}
+
+void DrawCommands::recordCommands(uint32_t frameIndex, uint32_t imageIndex, const std::vector<DrawItem>& drawItems) {
+	FrameCommands& frame = frames[frameIndex];
+	frame.primaryPool->reset();
+	if (multiDrawIndirect)
+		writeIndirectCommands(frame, drawItems);
+
+	uint32_t drawCount = static_cast<uint32_t>(drawItems.size());
+	uint32_t chunkCount = (drawCount + MIN_DRAWS_PER_RECORDING_THREAD - 1) / MIN_DRAWS_PER_RECORDING_THREAD;
+	chunkCount = std::min(std::max(chunkCount, 1u), recorderCount);
+	uint32_t chunkSize = (drawCount + chunkCount - 1) / chunkCount;
+
+	const DrawItem* items = drawItems.data();
+	JobGroup recording;
+	for (uint32_t chunk = 1; chunk < chunkCount; ++chunk) {
+		uint32_t first = std::min(chunk * chunkSize, drawCount);
+		uint32_t last = std::min(first + chunkSize, drawCount);
+		threadPool->enqueue(recording, [this, frameIndex, imageIndex, chunk, items, first, last] {
+			recordSecondary(frameIndex, imageIndex, chunk, items, first, last);
+		});
+	}
+	recordSecondary(frameIndex, imageIndex, 0, items, 0, std::min(chunkSize, drawCount));
+	recording.wait();
+
+	statistics = DrawStatistics();
+	for (uint32_t chunk = 0; chunk < chunkCount; ++chunk) {
+		const DrawStatistics& chunkStatistics = frame.chunkStatistics[chunk];
+		statistics.drawItems += chunkStatistics.drawItems;
+		statistics.drawCalls += chunkStatistics.drawCalls;
+		statistics.pipelineBinds += chunkStatistics.pipelineBinds;
+		statistics.descriptorSetBinds += chunkStatistics.descriptorSetBinds;
+		statistics.indexBufferBinds += chunkStatistics.indexBufferBinds;
+		statistics.constantPushes += chunkStatistics.constantPushes;
+		statistics.pipelineBindsSkipped += chunkStatistics.pipelineBindsSkipped;
+		statistics.indexBufferBindsSkipped += chunkStatistics.indexBufferBindsSkipped;
+		statistics.constantPushesSkipped += chunkStatistics.constantPushesSkipped;
+	}
+
+	recordPrimary(frameIndex, imageIndex, chunkCount);
 }
 
-void DrawCommands::createCommandBuffers() {
-	commandBuffers.resize(swapChain->getImageCount());
-	for (size_t i = 0; i < commandBuffers.size(); ++i)
-		commandBuffers[i] = new CommandBuffer(device, commandPool);
+void DrawCommands::writeIndirectCommands(FrameCommands& frame, const std::vector<DrawItem>& drawItems) {
+	// The slot's fence has signaled, so its buffer is free to be rewritten or replaced.
+	uint32_t drawCount = static_cast<uint32_t>(drawItems.size());
+	if (drawCount > frame.indirectCapacity) {
+		delete frame.indirectBuffer;
+		frame.indirectCapacity = std::max(std::max(drawCount, 2 * frame.indirectCapacity), MIN_INDIRECT_DRAW_CAPACITY);
+		frame.indirectBuffer = new Buffer(device, frame.indirectCapacity * sizeof(VkDrawIndexedIndirectCommand),
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		if (frame.indirectBuffer->getMappedData() == nullptr)
+			throw std::runtime_error("Failed to map indirect draw buffer.");
+	}
+	VkDrawIndexedIndirectCommand* commands = static_cast<VkDrawIndexedIndirectCommand*>(frame.indirectBuffer->getMappedData());
+	for (uint32_t i = 0; i < drawCount; ++i) {
+		const DrawItem& item = drawItems[i];
+		commands[i] = { item.indexCount, item.instanceCount, item.firstIndex, item.vertexOffset, item.firstInstance };
+	}
+	if (drawCount > 0)
+		device->getAllocator()->flush(frame.indirectBuffer->getAllocation(), 0, drawCount * sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void DrawCommands::recordSecondary(uint32_t frameIndex, uint32_t imageIndex, uint32_t chunk, const DrawItem* items, uint32_t first, uint32_t last) {
+	FrameCommands& frame = frames[frameIndex];
+	frame.workerPools[chunk]->reset();
+	// Each chunk counts into its own slot, so recording threads never share them.
+	DrawStatistics& chunkStatistics = frame.chunkStatistics[chunk];
+	chunkStatistics = DrawStatistics();
+	chunkStatistics.drawItems = last - first;
+	VkCommandBuffer commandBuffer = frame.secondaries[chunk]->getCommandBuffer();
+	frame.secondaries[chunk]->beginSecondaryCommands(renderPass->getRenderPass(), 0, framebuffers->getFrameBuffer(imageIndex));
+
+	// Dynamic state and bindings are not inherited from the primary, so every secondary sets its own.
+	VkViewport viewport{};
+	viewport.height = swapChain->getExtent().height;
+	viewport.width = swapChain->getExtent().width;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor{};
+	scissor.extent = swapChain->getExtent();
+	scissor.offset = { 0, 0 };
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	// All geometry lives in the pool, so the vertex streams are bound once. Every stream lives in the
+	// same buffer; pipelines that read fewer streams ignore the extra bindings.
+	const std::vector<VkDeviceSize>& streamOffsets = geometryPool->getStreamOffsets();
+	std::vector<VkBuffer> vertexBuffers(streamOffsets.size(), geometryPool->getVertexBufferRef()->getBuffer());
+	vkCmdBindVertexBuffers(commandBuffer, 0, static_cast<uint32_t>(streamOffsets.size()), vertexBuffers.data(), streamOffsets.data());
+
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipelineLayout(),
+		0, 1, &descriptorSets->getDescriptorSet(frameIndex), 0, nullptr);
+	chunkStatistics.descriptorSetBinds++;
+
+	// Every pipeline shares the layout, so pushed constants survive pipeline binds and are only pushed on change.
+	DrawConstants pushedConstants{};
+	bool pushed = false;
+	auto pushConstants = [&](const DrawConstants& constants) {
+		if (pushed && constants.objectIndex == pushedConstants.objectIndex &&
+			constants.lod == pushedConstants.lod && constants.material == pushedConstants.material) {
+			chunkStatistics.constantPushesSkipped++;
+			return;
+		}
+		vkCmdPushConstants(commandBuffer, pipeline->getPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants), &constants);
+		pushedConstants = constants;
+		pushed = true;
+		chunkStatistics.constantPushes++;
+	};
+
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+	for (uint32_t i = first; i < last;) {
+		const DrawItem* item = items + i;
+		// The index buffer is bound at its start, first indices of either type are counted from there.
+		if (item->indexType != boundIndexType) {
+			vkCmdBindIndexBuffer(commandBuffer, geometryPool->getIndexBufferRef()->getBuffer(), 0, item->indexType);
+			boundIndexType = item->indexType;
+			chunkStatistics.indexBufferBinds++;
+		}
+		else
+			chunkStatistics.indexBufferBindsSkipped++;
+		if (item->pipeline != boundPipeline) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, item->pipeline);
+			boundPipeline = item->pipeline;
+			chunkStatistics.pipelineBinds++;
+		}
+		else
+			chunkStatistics.pipelineBindsSkipped++;
+		if (!multiDrawIndirect) {
+			pushConstants(item->constants);
+			vkCmdDrawIndexed(commandBuffer, item->indexCount, item->instanceCount, item->firstIndex, item->vertexOffset, item->firstInstance);
+			chunkStatistics.drawCalls++;
+			i++;
+			continue;
+		}
+		// The draws of a run share one set of constants, so they find their objects through the instance
+		// list and the run ends where the level of detail or the material changes.
+		pushConstants({ DRAW_OBJECT_FROM_INSTANCE, item->constants.lod, item->constants.material });
+		uint32_t runLength = 1;
+		while (i + runLength < last && runLength < maxDrawIndirectCount &&
+			items[i + runLength].pipeline == item->pipeline && items[i + runLength].indexType == item->indexType &&
+			items[i + runLength].constants.lod == item->constants.lod && items[i + runLength].constants.material == item->constants.material)
+			runLength++;
+		vkCmdDrawIndexedIndirect(commandBuffer, frames[frameIndex].indirectBuffer->getBuffer(),
+			i * sizeof(VkDrawIndexedIndirectCommand), runLength, sizeof(VkDrawIndexedIndirectCommand));
+		chunkStatistics.drawCalls++;
+		i += runLength;
+	}
+
+	frame.secondaries[chunk]->endCommands();
 }
 
-void DrawCommands::recordCommands() {
+void DrawCommands::recordPrimary(uint32_t frameIndex, uint32_t imageIndex, uint32_t chunkCount) {
+	FrameCommands& frame = frames[frameIndex];
+	VkCommandBuffer commandBuffer = frame.primary->getCommandBuffer();
 
 	std::array<VkClearValue, 2> clearValues{};
 	clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
 	clearValues[1].depthStencil = { 1.0f, 0 };
 
 	VkRenderPassBeginInfo renderPassBeginInfo{};
-	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassBeginInfo.pNext = nullptr;
-	renderPassBeginInfo.renderPass = renderPass->getRenderPass();
-	renderPassBeginInfo.renderArea.offset.x = 0;
-	renderPassBeginInfo.renderArea.offset.y = 0;
-	renderPassBeginInfo.renderArea.extent = swapChain->getExtent();
-	renderPassBeginInfo.clearValueCount = 2;
-	renderPassBeginInfo.pClearValues = clearValues.data();
-
-	for (size_t i = 0; i < commandBuffers.size(); ++i) {
-
-		renderPassBeginInfo.framebuffer = framebuffers->getFrameBuffer(i);
-
-		commandBuffers[i]->beginCommands();
-
-		vkCmdBeginRenderPass(commandBuffers[i]->getCommandBuffer(), &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-		
-		VkViewport viewport{};
-		viewport.height = swapChain->getExtent().height;
-		viewport.width = swapChain->getExtent().width;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-		vkCmdSetViewport(commandBuffers[i]->getCommandBuffer(), 0, 1, &viewport);
-
-		VkRect2D scissor{};
-		scissor.extent = swapChain->getExtent();
-		scissor.offset = { 0, 0 };
-		vkCmdSetScissor(commandBuffers[i]->getCommandBuffer(), 0, 1, &scissor);
-		
-		VkBuffer vertexBuffers[] = { model->getVertexBufferRef()->getBuffer() };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffers[i]->getCommandBuffer(), 0, 1, vertexBuffers, offsets);
-
-		vkCmdBindIndexBuffer(commandBuffers[i]->getCommandBuffer(), model->getIndexBufferRef()->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
-
-		/*
-		vkCmdBindPipeline(commandBuffers[i]->getCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getGouraudPipeline());
-		uint32_t dynamicOffset = static_cast<uint32_t>(0 * uniformBuffers->getDynamicAlignment());
-		vkCmdBindDescriptorSets(commandBuffers[i]->getCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipelineLayout(),
-			0, 1, &descriptorSets->getDescriptorSet(i), 1, &dynamicOffset);
-		vkCmdDrawIndexed(commandBuffers[i]->getCommandBuffer(), model->getIndexCount(0), 1, model->getIndexOffset(0), 0, 0);
-		*/
-		// vkCmdBindDescriptorSets(commandBuffers[i]->getCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipelineLayout(), \
-			0, 1, &descriptorSets->getDescriptorSet(i), 0, nullptr);
-		
-		uint32_t dynamicOffset = static_cast<uint32_t>(0 * uniformBuffers->getDynamicAlignment());
-		vkCmdBindPipeline(commandBuffers[i]->getCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPhongPipeline());
-		vkCmdBindDescriptorSets(commandBuffers[i]->getCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipelineLayout(),
-			0, 1, &descriptorSets->getDescriptorSet(i), 1, &dynamicOffset);
-		vkCmdDrawIndexed(commandBuffers[i]->getCommandBuffer(), model->getIndexCount(0), 1, 
-			model->getIndexOffset(0), 0, 0);
-		
-		dynamicOffset = static_cast<uint32_t>(1 * uniformBuffers->getDynamicAlignment());
-		vkCmdBindPipeline(commandBuffers[i]->getCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getGouraudPipeline());
-		vkCmdBindDescriptorSets(commandBuffers[i]->getCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipelineLayout(),
-			0, 1, &descriptorSets->getDescriptorSet(i), 1, &dynamicOffset);
-		vkCmdDrawIndexed(commandBuffers[i]->getCommandBuffer(), model->getIndexCount(1), 1,
-			model->getIndexOffset(1), 0, 0);
-		
-		dynamicOffset = static_cast<uint32_t>(2 * uniformBuffers->getDynamicAlignment());
-		vkCmdBindPipeline(commandBuffers[i]->getCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getFlatPipeline());
-		vkCmdBindDescriptorSets(commandBuffers[i]->getCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipelineLayout(),
-			0, 1, &descriptorSets->getDescriptorSet(i), 1, &dynamicOffset);
-		vkCmdDrawIndexed(commandBuffers[i]->getCommandBuffer(), model->getIndexCount(2), 1,
-			model->getIndexOffset(2), 0, 0);
-		
-		vkCmdEndRenderPass(commandBuffers[i]->getCommandBuffer());
-
-		commandBuffers[i]->endCommands();
+	setupRenderPassBeginInfo(renderPassBeginInfo, clearValues, imageIndex);
+
+	frame.primary->beginSingalTimeCommands();
+
+	if (timestampQueryPool != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(commandBuffer, timestampQueryPool, 2 * frameIndex, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, 2 * frameIndex);
 	}
+
+	// Transfers are not allowed inside the render pass.
+	objectBuffer->recordUpload(commandBuffer, frameIndex);
+	vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+	std::vector<VkCommandBuffer> secondaries(chunkCount);
+	for (uint32_t i = 0; i < chunkCount; ++i)
+		secondaries[i] = frame.secondaries[i]->getCommandBuffer();
+	vkCmdExecuteCommands(commandBuffer, chunkCount, secondaries.data());
+	vkCmdEndRenderPass(commandBuffer);
+
+	if (timestampQueryPool != VK_NULL_HANDLE)
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, 2 * frameIndex + 1);
+
+	frame.primary->endCommands();
 }
 
 void DrawCommands::setupRenderPassBeginInfo(VkRenderPassBeginInfo& beginInfo, std::array<VkClearValue, 2>& clearValues, size_t index) {
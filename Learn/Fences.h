@@ -10,6 +10,7 @@ public:
 	void setFence(VkFence inFence, int index) { fences[index] = inFence; }
 	void createFences();
 	void resetFence(int index) { vkResetFences(device->getDevice(), 1, &fences[index]); }
+	void resize(int inNum);
 
 private:
 	LogicalDevice* device;
@@ -36,4 +37,10 @@ void Fences::createFences() {
 	for (int i = 0; i < num; ++i)
 		if (vkCreateFence(device->getDevice(), &fenceInfo, nullptr, &fences[i]) != VK_SUCCESS)
 			throw std::runtime_error("Failed to create fence.");
+}
+
+void Fences::resize(int inNum) {
+	// Only for fences borrowed with setFence; the slots are cleared rather than destroyed.
+	num = inNum;
+	fences.assign(num, VK_NULL_HANDLE);
 }
\ No newline at end of file
@@ -7,7 +7,7 @@
 class Framebuffers {
 public:
 	~Framebuffers();
-	Framebuffers(LogicalDevice* device, RenderPass* renderPass, SwapChain* swapChain);
+	Framebuffers(LogicalDevice* device, RenderPass* renderPass, SwapChain* swapChain, DepthResource* depthResource);
 	VkFramebuffer& getFrameBuffer(size_t index) { return framebuffers[index]; }
 
 private:
@@ -18,12 +18,14 @@ private:
 	LogicalDevice* device;
 	RenderPass* renderPass;
 	SwapChain* swapChain;
+	DepthResource* depthResource;
 };
 
-Framebuffers::Framebuffers(LogicalDevice* inDevice, RenderPass* inRenderPass, SwapChain* inSwapChain) {
+Framebuffers::Framebuffers(LogicalDevice* inDevice, RenderPass* inRenderPass, SwapChain* inSwapChain, DepthResource* inDepthResource) {
 	device = inDevice;
 	renderPass = inRenderPass;
 	swapChain = inSwapChain;
+	depthResource = inDepthResource;
 	createFramebuffers();
 }
 
@@ -38,7 +40,7 @@ void Framebuffers::createFramebuffers() {
 	for (uint32_t i = 0; i < swapChain->getImageCount(); ++i) {
 		std::array<VkImageView, 2> attachments = {
 			swapChain->getSwapChainResourcesRef(i)->getImageView(),
-			renderPass->getDepthResourceRef()->getImageView()
+			depthResource->getImageView()
 		};
 		
 		VkFramebufferCreateInfo framebufferCreateInfo{};
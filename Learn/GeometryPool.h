@@ -0,0 +1,520 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "LogicalDevice.h"
+#include "Buffer.h"
+#include "UploadManager.h"
+#include "DeletionQueue.h"
+#include "VertexLayout.h"
+
+typedef uint32_t GeometryHandle;
+const GeometryHandle INVALID_GEOMETRY_HANDLE = UINT32_MAX;
+
+// Initial sizes, an arena at least doubles whenever a mesh does not fit.
+const uint32_t DEFAULT_POOL_VERTEX_CAPACITY = 4u * 1024 * 1024;
+const VkDeviceSize DEFAULT_POOL_INDEX_CAPACITY = 64ull * 1024 * 1024;
+// A relocation is started once less than this share of an arena's free space is in its largest free range.
+const float GEOMETRY_POOL_COMPACTION_THRESHOLD = 0.5f;
+
+// First-fit suballocator over a linear range. Free ranges are kept sorted by offset and
+// merged with their neighbours, so allocations gather at the low end of the range.
+// The free size and the sizes of all free ranges are kept up to date on every change,
+// so the statistics never walk the ranges.
+class RangeAllocator {
+public:
+	RangeAllocator(uint64_t capacity);
+	bool allocate(uint64_t size, uint64_t alignment, uint64_t& offset) { return allocateBelow(size, alignment, capacity, offset); }
+	bool allocateBelow(uint64_t size, uint64_t alignment, uint64_t limit, uint64_t& offset);
+	void free(uint64_t offset, uint64_t size);
+	/** @brief Appends free space at the end of the range */
+	void grow(uint64_t newCapacity);
+	uint64_t getCapacity() { return capacity; }
+	uint64_t getFreeSize() { return freeSize; }
+	uint64_t getUsedSize() { return capacity - freeSize; }
+	uint64_t getLargestFreeRange() { return freeSizes.empty() ? 0 : *freeSizes.rbegin(); }
+	float getFragmentation();
+
+private:
+	void insertRange(uint64_t offset, uint64_t size);
+	std::map<uint64_t, uint64_t>::iterator eraseRange(std::map<uint64_t, uint64_t>::iterator range);
+
+	uint64_t capacity;
+	uint64_t freeSize;
+	std::map<uint64_t, uint64_t> freeRanges;
+	std::multiset<uint64_t> freeSizes;
+};
+
+RangeAllocator::RangeAllocator(uint64_t inCapacity) {
+	capacity = inCapacity;
+	freeSize = capacity;
+	if (capacity > 0)
+		insertRange(0, capacity);
+}
+
+void RangeAllocator::insertRange(uint64_t offset, uint64_t size) {
+	freeRanges[offset] = size;
+	freeSizes.insert(size);
+}
+
+std::map<uint64_t, uint64_t>::iterator RangeAllocator::eraseRange(std::map<uint64_t, uint64_t>::iterator range) {
+	freeSizes.erase(freeSizes.find(range->second));
+	return freeRanges.erase(range);
+}
+
+bool RangeAllocator::allocateBelow(uint64_t size, uint64_t alignment, uint64_t limit, uint64_t& offset) {
+	if (size == 0) {
+		offset = 0;
+		return true;
+	}
+	for (auto range = freeRanges.begin(); range != freeRanges.end() && range->first < limit; ++range) {
+		uint64_t start = range->first;
+		uint64_t end = range->first + range->second;
+		uint64_t aligned = (start + alignment - 1) / alignment * alignment;
+		if (aligned + size > end || aligned + size > limit)
+			continue;
+
+		eraseRange(range);
+		if (aligned > start)
+			insertRange(start, aligned - start);
+		if (aligned + size < end)
+			insertRange(aligned + size, end - aligned - size);
+		freeSize -= size;
+		offset = aligned;
+		return true;
+	}
+	return false;
+}
+
+void RangeAllocator::free(uint64_t offset, uint64_t size) {
+	if (size == 0)
+		return;
+	freeSize += size;
+	auto next = freeRanges.lower_bound(offset);
+	if (next != freeRanges.end() && offset + size == next->first) {
+		size += next->second;
+		next = eraseRange(next);
+	}
+	if (next != freeRanges.begin()) {
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset) {
+			offset = previous->first;
+			size += previous->second;
+			eraseRange(previous);
+		}
+	}
+	insertRange(offset, size);
+}
+
+void RangeAllocator::grow(uint64_t newCapacity) {
+	if (newCapacity <= capacity)
+		return;
+	uint64_t oldCapacity = capacity;
+	capacity = newCapacity;
+	free(oldCapacity, newCapacity - oldCapacity);
+}
+
+float RangeAllocator::getFragmentation() {
+	return freeSize == 0 ? 0.0f : 1.0f - static_cast<float>(getLargestFreeRange()) / static_cast<float>(freeSize);
+}
+
+// Long-lived device-local vertex and index buffers shared by all meshes, suballocated per mesh.
+// Vertices are allocated in whole vertices: every stream has a fixed region of the vertex buffer,
+// so a mesh occupies the same vertex range in each of them and the streams are bound once per frame.
+// Index ranges are allocated in bytes and hold a mesh's 16-bit indices followed by its 32-bit ones.
+// Removed ranges return to the free lists once the frames that may still read them have finished.
+// update() moves one live range at a time towards the start of its arena with a GPU copy when
+// the free space gets fragmented; the mesh switches to its new range once the copy has completed.
+// An arena that is full is grown into a larger buffer holding a copy of the old one. Frames keep
+// drawing the old buffer until that copy has completed, then it is retired through the deletion queue.
+class GeometryPool {
+public:
+	~GeometryPool();
+	GeometryPool(LogicalDevice* device, UploadManager* uploadManager, VertexLayout* vertexLayout,
+		uint32_t vertexCapacity = DEFAULT_POOL_VERTEX_CAPACITY, VkDeviceSize indexCapacity = DEFAULT_POOL_INDEX_CAPACITY);
+
+	GeometryHandle add(const std::vector<uint8_t>& vertexData, const std::vector<uint16_t>& indexData16, const std::vector<uint32_t>& indexData32);
+	void remove(GeometryHandle handle, DeletionQueue* deletionQueue = nullptr);
+	void update(DeletionQueue* deletionQueue);
+	/** @brief Whether the upload of a mesh has completed and the buffers drawn from hold it */
+	bool isResident(GeometryHandle handle) { return !growth.active && uploadManager->isComplete(allocations[handle].ticket); }
+
+	Buffer* getVertexBufferRef() { return drawVertexBuffer; }
+	Buffer* getIndexBufferRef() { return drawIndexBuffer; }
+	/** @brief Start of every vertex stream in the vertex buffer, bound at the stream's binding */
+	const std::vector<VkDeviceSize>& getStreamOffsets() { return drawStreamOffsets; }
+	/** @brief Vertex offset of a mesh's first vertex */
+	uint32_t getVertexBase(GeometryHandle handle) { return static_cast<uint32_t>(allocations[handle].offset[ARENA_VERTICES]); }
+	/** @brief First index of a mesh's 16-bit or 32-bit indices, with the index buffer bound at offset zero */
+	uint32_t getIndexBase(GeometryHandle handle, VkIndexType indexType);
+
+private:
+	enum Arena {
+		ARENA_VERTICES,
+		ARENA_INDICES,
+		ARENA_COUNT
+	};
+
+	struct Allocation {
+		bool live = false;
+		uint64_t offset[ARENA_COUNT];
+		uint64_t size[ARENA_COUNT];
+		VkDeviceSize index32Offset;
+		UploadTicket ticket;
+	};
+
+	struct Relocation {
+		bool active = false;
+		GeometryHandle handle;
+		Arena arena;
+		uint64_t offset;
+		UploadTicket ticket;
+	};
+
+	struct Growth {
+		bool active = false;
+		UploadTicket ticket;
+		// Every buffer replaced since the last switch, including the ones still drawn from
+		std::vector<Buffer*> retiredBuffers;
+	};
+
+	void createVertexBuffer(uint32_t vertexCapacity);
+	void createIndexBuffer(VkDeviceSize indexCapacity);
+	bool allocate(Arena arena, uint64_t size, uint64_t& offset);
+	void grow(Arena arena, uint64_t size);
+	void finishGrowth(DeletionQueue* deletionQueue);
+	std::vector<VkBufferCopy> getLiveRegions(Arena arena);
+	bool startRelocation(Arena arena);
+	void copyRange(Arena arena, uint64_t srcOffset, uint64_t dstOffset, uint64_t size);
+	void recordCopyBarrier(VkCommandBuffer commandBuffer, Buffer* buffer);
+	void release(Arena arena, uint64_t offset, uint64_t size, DeletionQueue* deletionQueue);
+	void track(Arena arena, GeometryHandle handle);
+	void untrack(Arena arena, GeometryHandle handle);
+	static uint64_t getAlignment(Arena arena) { return arena == ARENA_INDICES ? 4 : 1; }
+
+	LogicalDevice* device;
+	UploadManager* uploadManager;
+	VertexLayout* vertexLayout;
+	// Uploads and copies write the newest buffers, draws read the ones every resident mesh is in.
+	Buffer* vertexBuffer;
+	Buffer* indexBuffer;
+	std::vector<VkDeviceSize> streamOffsets;
+	Buffer* drawVertexBuffer;
+	Buffer* drawIndexBuffer;
+	std::vector<VkDeviceSize> drawStreamOffsets;
+
+	std::vector<RangeAllocator> allocators;
+	std::vector<Allocation> allocations;
+	std::vector<GeometryHandle> freeHandles;
+	// Live allocations of each arena by offset, walked from the end when looking for a range to move
+	std::map<uint64_t, GeometryHandle> liveRanges[ARENA_COUNT];
+	Relocation relocation;
+	Growth growth;
+};
+
+GeometryPool::~GeometryPool() {
+	delete vertexBuffer;
+	delete indexBuffer;
+	for (Buffer* buffer : growth.retiredBuffers)
+		delete buffer;
+}
+
+GeometryPool::GeometryPool(LogicalDevice* inDevice, UploadManager* inUploadManager, VertexLayout* inVertexLayout,
+	uint32_t vertexCapacity, VkDeviceSize indexCapacity) {
+	device = inDevice;
+	uploadManager = inUploadManager;
+	vertexLayout = inVertexLayout;
+	allocators.emplace_back(vertexCapacity);
+	allocators.emplace_back(indexCapacity);
+	createVertexBuffer(vertexCapacity);
+	createIndexBuffer(indexCapacity);
+	drawVertexBuffer = vertexBuffer;
+	drawIndexBuffer = indexBuffer;
+	drawStreamOffsets = streamOffsets;
+}
+
+// Transfer source as well, compaction and growth copy out of the buffers. Meshes are uploaded on the
+// transfer queue while the graphics queue draws from the same buffers, so both queues share them.
+void GeometryPool::createVertexBuffer(uint32_t vertexCapacity) {
+	VkDeviceSize vertexBufferSize = 0;
+	streamOffsets.resize(vertexLayout->getStreamCount());
+	for (uint32_t stream = 0; stream < vertexLayout->getStreamCount(); ++stream) {
+		streamOffsets[stream] = vertexBufferSize;
+		vertexBufferSize += (static_cast<VkDeviceSize>(vertexCapacity) * vertexLayout->stride(stream) + 15) & ~static_cast<VkDeviceSize>(15);
+	}
+	vertexBuffer = new Buffer(device, vertexBufferSize,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, uploadManager->getSharingFamilies());
+}
+
+void GeometryPool::createIndexBuffer(VkDeviceSize indexCapacity) {
+	indexBuffer = new Buffer(device, indexCapacity,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, uploadManager->getSharingFamilies());
+}
+
+GeometryHandle GeometryPool::add(const std::vector<uint8_t>& vertexData, const std::vector<uint16_t>& indexData16, const std::vector<uint32_t>& indexData32) {
+	uint32_t stride = vertexLayout->stride();
+	uint64_t vertexCount = vertexData.size() / stride;
+	VkDeviceSize size16 = static_cast<VkDeviceSize>(indexData16.size()) * sizeof(uint16_t);
+	VkDeviceSize size32 = static_cast<VkDeviceSize>(indexData32.size()) * sizeof(uint32_t);
+
+	Allocation allocation{};
+	allocation.live = true;
+	allocation.size[ARENA_VERTICES] = vertexCount;
+	allocation.index32Offset = (size16 + 3) & ~static_cast<VkDeviceSize>(3);
+	allocation.size[ARENA_INDICES] = allocation.index32Offset + size32;
+	bool grown = allocate(ARENA_VERTICES, vertexCount, allocation.offset[ARENA_VERTICES]);
+	grown |= allocate(ARENA_INDICES, allocation.size[ARENA_INDICES], allocation.offset[ARENA_INDICES]);
+
+	// The interleaved vertices are split into the stream regions, each range holding the mesh's vertices in that stream.
+	for (uint32_t stream = 0; stream < vertexLayout->getStreamCount(); ++stream) {
+		uint32_t streamStride = vertexLayout->stride(stream);
+		uint32_t sourceOffset = vertexLayout->streamOffset(stream);
+		std::vector<uint8_t> streamData(static_cast<size_t>(vertexCount * streamStride));
+		for (size_t v = 0; v < vertexCount; ++v)
+			memcpy(streamData.data() + v * streamStride, vertexData.data() + v * stride + sourceOffset, streamStride);
+		if (!streamData.empty())
+			uploadManager->uploadToBuffer(vertexBuffer, streamData.data(), streamData.size(),
+				streamOffsets[stream] + allocation.offset[ARENA_VERTICES] * streamStride);
+	}
+	if (size16 > 0)
+		uploadManager->uploadToBuffer(indexBuffer, indexData16.data(), size16, allocation.offset[ARENA_INDICES]);
+	if (size32 > 0)
+		uploadManager->uploadToBuffer(indexBuffer, indexData32.data(), size32, allocation.offset[ARENA_INDICES] + allocation.index32Offset);
+	allocation.ticket = uploadManager->submit();
+	// The growth copy went into the same batch.
+	if (grown)
+		growth.ticket = allocation.ticket;
+
+	GeometryHandle handle;
+	if (!freeHandles.empty()) {
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+		allocations[handle] = allocation;
+	}
+	else {
+		handle = static_cast<GeometryHandle>(allocations.size());
+		allocations.push_back(allocation);
+	}
+	track(ARENA_VERTICES, handle);
+	track(ARENA_INDICES, handle);
+	return handle;
+}
+
+bool GeometryPool::allocate(Arena arena, uint64_t size, uint64_t& offset) {
+	// Returns whether the arena had to grow. The grown space is appended to the free range at the end,
+	// so the allocation fits right after.
+	if (allocators[arena].allocate(size, getAlignment(arena), offset))
+		return false;
+	grow(arena, size);
+	if (!allocators[arena].allocate(size, getAlignment(arena), offset))
+		throw std::runtime_error("Failed to allocate from the geometry pool.");
+	return true;
+}
+
+void GeometryPool::grow(Arena arena, uint64_t size) {
+	// Recorded on the graphics side of the upload batch like compaction, behind every copy recorded before.
+	// Only live ranges are copied: the mesh being added may already have been given free space below the
+	// old end, and its upload on the transfer queue runs before this copy.
+	uint64_t capacity = allocators[arena].getCapacity();
+	uint64_t newCapacity = std::max(2 * capacity, capacity + size + getAlignment(arena));
+	VkCommandBuffer commandBuffer = uploadManager->getGraphicsCommandBuffer();
+	std::vector<VkBufferCopy> liveRegions = getLiveRegions(arena);
+
+	Buffer* oldBuffer;
+	std::vector<VkBufferCopy> regions;
+	if (arena == ARENA_INDICES) {
+		oldBuffer = indexBuffer;
+		createIndexBuffer(newCapacity);
+		regions = liveRegions;
+	}
+	else {
+		if (newCapacity > UINT32_MAX)
+			throw std::runtime_error("Failed to grow the geometry pool, vertex offsets exceed 32 bits.");
+		// The streams are laid out by capacity, so each one moves to its new region.
+		oldBuffer = vertexBuffer;
+		std::vector<VkDeviceSize> oldStreamOffsets = streamOffsets;
+		createVertexBuffer(static_cast<uint32_t>(newCapacity));
+		for (uint32_t stream = 0; stream < vertexLayout->getStreamCount(); ++stream) {
+			VkDeviceSize streamStride = vertexLayout->stride(stream);
+			for (const VkBufferCopy& region : liveRegions)
+				regions.push_back({ oldStreamOffsets[stream] + region.srcOffset * streamStride, streamOffsets[stream] + region.dstOffset * streamStride,
+					region.size * streamStride });
+		}
+	}
+	Buffer* newBuffer = arena == ARENA_INDICES ? indexBuffer : vertexBuffer;
+	recordCopyBarrier(commandBuffer, oldBuffer);
+	if (!regions.empty())
+		vkCmdCopyBuffer(commandBuffer, oldBuffer->getBuffer(), newBuffer->getBuffer(), static_cast<uint32_t>(regions.size()), regions.data());
+	growth.retiredBuffers.push_back(oldBuffer);
+	allocators[arena].grow(newCapacity);
+	growth.active = true;
+}
+
+std::vector<VkBufferCopy> GeometryPool::getLiveRegions(Arena arena) {
+	// In arena units with neighbouring ranges merged. A range a mesh is being moved to is live as well.
+	std::map<uint64_t, uint64_t> ranges;
+	for (auto& range : liveRanges[arena])
+		ranges[range.first] = allocations[range.second].size[arena];
+	if (relocation.active && relocation.arena == arena)
+		ranges[relocation.offset] = allocations[relocation.handle].size[arena];
+
+	std::vector<VkBufferCopy> regions;
+	for (auto& range : ranges) {
+		if (!regions.empty() && regions.back().srcOffset + regions.back().size == range.first)
+			regions.back().size += range.second;
+		else
+			regions.push_back({ range.first, range.first, range.second });
+	}
+	return regions;
+}
+
+void GeometryPool::finishGrowth(DeletionQueue* deletionQueue) {
+	// Frames in flight still draw the old buffers, so they are only destroyed after them.
+	growth.active = false;
+	drawVertexBuffer = vertexBuffer;
+	drawIndexBuffer = indexBuffer;
+	drawStreamOffsets = streamOffsets;
+	std::vector<Buffer*> retiredBuffers;
+	retiredBuffers.swap(growth.retiredBuffers);
+	deletionQueue->push([retiredBuffers] {
+		for (Buffer* buffer : retiredBuffers)
+			delete buffer;
+	});
+}
+
+void GeometryPool::track(Arena arena, GeometryHandle handle) {
+	const Allocation& allocation = allocations[handle];
+	if (allocation.size[arena] > 0)
+		liveRanges[arena][allocation.offset[arena]] = handle;
+}
+
+void GeometryPool::untrack(Arena arena, GeometryHandle handle) {
+	const Allocation& allocation = allocations[handle];
+	if (allocation.size[arena] > 0)
+		liveRanges[arena].erase(allocation.offset[arena]);
+}
+
+void GeometryPool::remove(GeometryHandle handle, DeletionQueue* deletionQueue) {
+	// Without a deletion queue the caller guarantees that the device no longer reads the ranges.
+	Allocation& allocation = allocations[handle];
+	allocation.live = false;
+	untrack(ARENA_VERTICES, handle);
+	untrack(ARENA_INDICES, handle);
+	for (int arena = 0; arena < ARENA_COUNT; ++arena)
+		release(static_cast<Arena>(arena), allocation.offset[arena], allocation.size[arena], deletionQueue);
+	// A range the mesh was being moved to is released when its copy has finished.
+	if (!(relocation.active && relocation.handle == handle)) {
+		if (deletionQueue)
+			deletionQueue->push([this, handle] { freeHandles.push_back(handle); });
+		else
+			freeHandles.push_back(handle);
+	}
+}
+
+void GeometryPool::release(Arena arena, uint64_t offset, uint64_t size, DeletionQueue* deletionQueue) {
+	if (deletionQueue)
+		deletionQueue->push([this, arena, offset, size] { allocators[arena].free(offset, size); });
+	else
+		allocators[arena].free(offset, size);
+}
+
+uint32_t GeometryPool::getIndexBase(GeometryHandle handle, VkIndexType indexType) {
+	const Allocation& allocation = allocations[handle];
+	if (indexType == VK_INDEX_TYPE_UINT16)
+		return static_cast<uint32_t>(allocation.offset[ARENA_INDICES] / sizeof(uint16_t));
+	return static_cast<uint32_t>((allocation.offset[ARENA_INDICES] + allocation.index32Offset) / sizeof(uint32_t));
+}
+
+void GeometryPool::update(DeletionQueue* deletionQueue) {
+	// Nothing is moved while the buffers drawn from are not the ones written to.
+	if (growth.active) {
+		if (!uploadManager->isComplete(growth.ticket))
+			return;
+		finishGrowth(deletionQueue);
+	}
+
+	// Draws recorded before the switch still read the old range, so it is only released after them.
+	if (relocation.active) {
+		if (!uploadManager->isComplete(relocation.ticket))
+			return;
+		relocation.active = false;
+		Allocation& allocation = allocations[relocation.handle];
+		uint64_t size = allocation.size[relocation.arena];
+		if (!allocation.live) {
+			release(relocation.arena, relocation.offset, size, deletionQueue);
+			GeometryHandle handle = relocation.handle;
+			deletionQueue->push([this, handle] { freeHandles.push_back(handle); });
+			return;
+		}
+		release(relocation.arena, allocation.offset[relocation.arena], size, deletionQueue);
+		untrack(relocation.arena, relocation.handle);
+		allocation.offset[relocation.arena] = relocation.offset;
+		track(relocation.arena, relocation.handle);
+	}
+
+	for (int arena = 0; arena < ARENA_COUNT; ++arena)
+		if (allocators[arena].getFragmentation() > GEOMETRY_POOL_COMPACTION_THRESHOLD && startRelocation(static_cast<Arena>(arena)))
+			return;
+}
+
+bool GeometryPool::startRelocation(Arena arena) {
+	// The highest range that fits into a free range below it moves there, which grows the free space at the end.
+	for (auto range = liveRanges[arena].rbegin(); range != liveRanges[arena].rend(); ++range) {
+		GeometryHandle handle = range->second;
+		const Allocation& allocation = allocations[handle];
+		if (!uploadManager->isComplete(allocation.ticket))
+			continue;
+		uint64_t offset;
+		if (!allocators[arena].allocateBelow(allocation.size[arena], getAlignment(arena), allocation.offset[arena], offset))
+			continue;
+		copyRange(arena, allocation.offset[arena], offset, allocation.size[arena]);
+		relocation.active = true;
+		relocation.handle = handle;
+		relocation.arena = arena;
+		relocation.offset = offset;
+		relocation.ticket = uploadManager->submit();
+		return true;
+	}
+	return false;
+}
+
+void GeometryPool::copyRange(Arena arena, uint64_t srcOffset, uint64_t dstOffset, uint64_t size) {
+	// Recorded on the graphics side of the upload batch. The ranges never overlap: the destination was
+	// free and lies below the source.
+	VkCommandBuffer commandBuffer = uploadManager->getGraphicsCommandBuffer();
+	Buffer* buffer = arena == ARENA_INDICES ? indexBuffer : vertexBuffer;
+	recordCopyBarrier(commandBuffer, buffer);
+
+	if (arena == ARENA_INDICES) {
+		VkBufferCopy region{ srcOffset, dstOffset, size };
+		vkCmdCopyBuffer(commandBuffer, buffer->getBuffer(), buffer->getBuffer(), 1, &region);
+		return;
+	}
+	std::vector<VkBufferCopy> regions;
+	for (uint32_t stream = 0; stream < vertexLayout->getStreamCount(); ++stream) {
+		VkDeviceSize streamStride = vertexLayout->stride(stream);
+		regions.push_back({ streamOffsets[stream] + srcOffset * streamStride, streamOffsets[stream] + dstOffset * streamStride, size * streamStride });
+	}
+	vkCmdCopyBuffer(commandBuffer, buffer->getBuffer(), buffer->getBuffer(), static_cast<uint32_t>(regions.size()), regions.data());
+}
+
+void GeometryPool::recordCopyBarrier(VkCommandBuffer commandBuffer, Buffer* buffer) {
+	// Uploads of the same batch may have just written the buffer on the transfer queue.
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer->getBuffer();
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
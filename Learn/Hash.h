@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+const uint64_t FNV_PRIME = 1099511628211ull;
+
+// 64-bit FNV-1a. Pass the previous result as seed to hash several ranges as one stream.
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = FNV_OFFSET_BASIS) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+template <typename T>
+inline uint64_t hashValue(const T& value, uint64_t seed = FNV_OFFSET_BASIS) {
+	return hashBytes(&value, sizeof(T), seed);
+}
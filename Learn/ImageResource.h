@@ -2,6 +2,7 @@
 
 #include "CommandPool.h"
 #include "CommandBuffer.h"
+#include "MemoryAllocator.h"
 
 class ImageResource {
 public:
@@ -24,19 +25,19 @@ protected:
 	void setWidth(uint32_t inWidth) { width = inWidth; }
 	void setHeight(uint32_t inHeight) { height = inHeight; }
 	void setMipLevels(uint32_t inMipLevels) { mipLevels = inMipLevels; }
-	void transitImageLayout(CommandPool* commandPool, VkImageLayout oldLayout, VkImageLayout newLayout);
+	void transitImageLayout(VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout);
 	
 	LogicalDevice* device;
 	uint32_t width, height, mipLevels;
 	VkFormat format = VK_FORMAT_UNDEFINED;
 
-	VkDeviceMemory memory = VK_NULL_HANDLE;
+	MemoryAllocation allocation;
 	VkImage image = VK_NULL_HANDLE;
 	VkImageView imageView = VK_NULL_HANDLE;
 
 private:
 	void createImage(VkSampleCountFlagBits samples, VkImageTiling tiling, VkImageUsageFlags usage);
-	void allocateImageMemory(VkMemoryPropertyFlags properties);
+	void allocateImageMemory(VkMemoryPropertyFlags properties, VkImageTiling tiling);
 	void setupImageMemoryBarrier(VkImageMemoryBarrier& barrier, VkImageLayout oldLayout, VkImageLayout newLayout);
 	void setupAccessMaskAndStage(VkImageMemoryBarrier& barrier, VkPipelineStageFlags& srcStage, VkPipelineStageFlags& dstStage,
 		VkImageLayout oldLayout, VkImageLayout newLayout);
@@ -48,8 +49,8 @@ ImageResource::~ImageResource() {
 		vkDestroyImageView(device->getDevice(), imageView, nullptr);
 	if (image != VK_NULL_HANDLE)
 		vkDestroyImage(device->getDevice(), image, nullptr);
-	if (memory != VK_NULL_HANDLE)
-		vkFreeMemory(device->getDevice(), memory, nullptr);
+	if (allocation.memory != VK_NULL_HANDLE)
+		device->getAllocator()->free(allocation);
 }
 
 ImageResource::ImageResource(LogicalDevice* inDevice) {
@@ -67,8 +68,8 @@ void ImageResource::createImageResource(VkSampleCountFlagBits samples, VkFormat
 	VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImageAspectFlags aspect) {
 	format = inFormat;
 	createImage(samples, tiling, usage);
-	allocateImageMemory(properties);
-	vkBindImageMemory(device->getDevice(), image, memory, 0);
+	allocateImageMemory(properties, tiling);
+	vkBindImageMemory(device->getDevice(), image, allocation.memory, allocation.offset);
 	createImageView(aspect);
 }
 
@@ -92,17 +93,12 @@ void ImageResource::createImage(VkSampleCountFlagBits samples, VkImageTiling til
 		throw std::runtime_error("Failed to create image.");
 }
 
-void ImageResource::allocateImageMemory(VkMemoryPropertyFlags properties) {
+void ImageResource::allocateImageMemory(VkMemoryPropertyFlags properties, VkImageTiling tiling) {
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(device->getDevice(), image, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = device->getPhysicalDevice()->retrieveMemoryTypeIndex(memRequirements.memoryTypeBits, properties);
-
-	if (vkAllocateMemory(device->getDevice(), &allocInfo, nullptr, &memory) != VK_SUCCESS)
-		throw std::runtime_error("Failed to allocate texture image memory.");
+	MemoryPoolType poolType = (tiling == VK_IMAGE_TILING_OPTIMAL) ? MEMORY_POOL_OPTIMAL : MEMORY_POOL_LINEAR;
+	allocation = device->getAllocator()->allocate(memRequirements, properties, poolType);
 }
 
 void ImageResource::createImageView(VkImageAspectFlags aspect) {
@@ -127,25 +123,21 @@ void ImageResource::createImageView(VkImageAspectFlags aspect) {
 		throw std::runtime_error("Failed to create image view.");
 }
 
-void ImageResource::transitImageLayout(CommandPool* commandPool, VkImageLayout oldLayout, VkImageLayout newLayout) {
+void ImageResource::transitImageLayout(VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout) {
 	VkImageMemoryBarrier barrier{};
 	setupImageMemoryBarrier(barrier, oldLayout, newLayout);
 
 	VkPipelineStageFlags srcStage, dstStage;
 	setupAccessMaskAndStage(barrier, srcStage, dstStage, oldLayout, newLayout);
 	
-	CommandBuffer buffer(device, commandPool);
-	buffer.beginSingalTimeCommands();
-
 	vkCmdPipelineBarrier(
-		buffer.getCommandBuffer(),
+		commandBuffer,
 		srcStage, dstStage,
 		0,
 		0, nullptr,
 		0, nullptr,
 		1, &barrier
 	);
-	buffer.endSingalTimeCommands();
 }
 
 void ImageResource::setupImageMemoryBarrier(VkImageMemoryBarrier& barrier, VkImageLayout oldLayout, VkImageLayout newLayout) {
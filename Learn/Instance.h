@@ -7,7 +7,7 @@
 class Instance {
 public:
 	~Instance();
-	Instance(ValidationDebugger* debugger);
+	Instance(ValidationDebugger* debugger, bool presentable = true);
 	void destroyInstance() { vkDestroyInstance(instance, nullptr); };
 	VkInstance instance;
 
@@ -19,6 +19,7 @@ private:
 	void setupInstanceCreateInfo(VkInstanceCreateInfo& createInfo, VkApplicationInfo& appInfo);
 
 	ValidationDebugger* debugger;
+	bool presentable;
 	std::vector<const char*> extensions;
 };
 
@@ -27,8 +28,9 @@ Instance::~Instance() {
 	vkDestroyInstance(instance, nullptr);
 }
 
-Instance::Instance(ValidationDebugger* inDebugger) {
+Instance::Instance(ValidationDebugger* inDebugger, bool inPresentable) {
 	debugger = inDebugger;
+	presentable = inPresentable;
 	createInstance();
 	if (debugger->isEnable())
 		debugger->createDebugMessenger(instance, nullptr);
@@ -72,13 +74,15 @@ void Instance::setupInstanceCreateInfo(VkInstanceCreateInfo& createInfo, VkAppli
 }
 
 void Instance::retrieveRequiredExtensions() {
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
 	extensions.clear();
-	for (int i = 0; i < glfwExtensionCount; ++i)
-		extensions.push_back(glfwExtensions[i]);
+	if (presentable) {
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+		for (uint32_t i = 0; i < glfwExtensionCount; ++i)
+			extensions.push_back(glfwExtensions[i]);
+	}
 
 	if (debugger->isEnable())
 		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "AssimpModel.h"
+
+// Largest allowed on-screen geometric error of a LOD, in pixels.
+const float LOD_PIXEL_ERROR = 1.0f;
+// A coarser level must be this much under the threshold before it replaces the current one,
+// so objects sitting at a switching distance do not flicker between two levels.
+const float LOD_HYSTERESIS = 0.25f;
+
+// Picks a level of detail per object from the projected size of its bounding sphere.
+class LodSelector {
+public:
+	LodSelector(AssimpModel* model, float pixelError = LOD_PIXEL_ERROR, float hysteresis = LOD_HYSTERESIS);
+	void setView(glm::vec3 cameraPosition, float fovyDegrees, uint32_t viewportHeight);
+	uint32_t select(uint32_t objectIndex, int modelIndex, const glm::mat4& modelMatrix);
+
+private:
+	AssimpModel* model;
+	float pixelError;
+	float hysteresis;
+
+	glm::vec3 cameraPosition;
+	float projectionScale = 1.0f;
+	std::vector<uint32_t> currentLods;
+};
+
+LodSelector::LodSelector(AssimpModel* inModel, float inPixelError, float inHysteresis) {
+	model = inModel;
+	pixelError = inPixelError;
+	hysteresis = inHysteresis;
+}
+
+void LodSelector::setView(glm::vec3 inCameraPosition, float fovyDegrees, uint32_t viewportHeight) {
+	cameraPosition = inCameraPosition;
+	// Pixels covered by one unit at distance one.
+	projectionScale = viewportHeight / (2.0f * std::tan(glm::radians(fovyDegrees) * 0.5f));
+}
+
+uint32_t LodSelector::select(uint32_t objectIndex, int modelIndex, const glm::mat4& modelMatrix) {
+	if (objectIndex >= currentLods.size())
+		currentLods.resize(objectIndex + 1, 0);
+	uint32_t& current = currentLods[objectIndex];
+	uint32_t lodCount = model->getLodCount(modelIndex);
+	current = std::min(current, lodCount - 1);
+
+	glm::vec4 sphere = model->getBoundingSphere(modelIndex);
+	glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(glm::vec3(sphere), 1.0f));
+	float scale = std::max(glm::length(glm::vec3(modelMatrix[0])), std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+	float radius = sphere.w * scale;
+
+	// Distance to the nearest point of the sphere, inside it the full mesh is always used.
+	float distance = glm::length(center - cameraPosition) - radius;
+	if (distance <= 0.0f) {
+		current = 0;
+		return current;
+	}
+	float pixelsPerUnit = projectionScale / distance;
+
+	// Coarsest level within the threshold; moving to a coarser level than the current one needs the hysteresis margin.
+	for (uint32_t lod = lodCount - 1; lod > 0; --lod) {
+		float projectedError = model->getLodError(modelIndex, lod) * scale * pixelsPerUnit;
+		float threshold = lod > current ? pixelError * (1.0f - hysteresis) : pixelError;
+		if (projectedError <= threshold) {
+			current = lod;
+			return current;
+		}
+	}
+	current = 0;
+	return current;
+}
@@ -3,6 +3,8 @@
 #include "ValidationDebugger.h"
 #include "PhysicalDevice.h"
 
+class MemoryAllocator;
+
 class LogicalDevice {
 public:
 	~LogicalDevice();
@@ -10,7 +12,13 @@ public:
 	VkDevice& getDevice() { return device; }
 	VkQueue& getGraphicQueue() { return graphicQueue; }
 	VkQueue& getPresentQueue() { return presentQueue; }
+	VkQueue& getTransferQueue() { return transferQueue; }
+	VkQueue& getComputeQueue() { return computeQueue; }
+	bool hasDedicatedTransferQueue() { return physicalDevice->getTransferQueueIndex() != physicalDevice->getGraphicQueueIndex(); }
+	bool hasDedicatedComputeQueue() { return physicalDevice->getComputeQueueIndex() != physicalDevice->getGraphicQueueIndex(); }
 	PhysicalDevice* getPhysicalDevice() { return physicalDevice; }
+	MemoryAllocator* getAllocator() { return allocator; }
+	void setAllocator(MemoryAllocator* inAllocator) { allocator = inAllocator; }
 
 private:
 	void createDevice();
@@ -21,9 +29,11 @@ private:
 	PhysicalDevice* physicalDevice;
 	ValidationDebugger* debugger;
 	VkDevice device;
-	std::vector<const char*> extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+	MemoryAllocator* allocator = nullptr;
 	VkQueue graphicQueue;
 	VkQueue presentQueue;
+	VkQueue transferQueue;
+	VkQueue computeQueue;
 };
 
 LogicalDevice::~LogicalDevice() {
@@ -51,7 +61,8 @@ void LogicalDevice::createDevice() {
 
 void LogicalDevice::retrieveQueueCreateInfos(std::vector<VkDeviceQueueCreateInfo>& queueCreateInfos, float queuePriority) {
 	QueueFamilyIndices familyIndices = physicalDevice->getQueueFamilyIndices();
-	std::set<uint32_t> uniqueFamilyIndices = { familyIndices.graphic.value(), familyIndices.present.value() };
+	std::set<uint32_t> uniqueFamilyIndices = { familyIndices.graphic.value(), familyIndices.present.value(),
+		familyIndices.transfer.value(), familyIndices.compute.value() };
 	for (uint32_t queueFamily : uniqueFamilyIndices) {
 		VkDeviceQueueCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
@@ -66,8 +77,8 @@ void LogicalDevice::setupDeviceCreateInfo(VkDeviceCreateInfo& deviceCreateInfo,
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
-	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
-	deviceCreateInfo.ppEnabledExtensionNames = extensions.data();
+	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(physicalDevice->getExtensions().size());
+	deviceCreateInfo.ppEnabledExtensionNames = physicalDevice->getExtensions().data();
 	deviceCreateInfo.pEnabledFeatures = &physicalDevice->getFeatures();
 	if (debugger->isEnable()) {
 		deviceCreateInfo.enabledLayerCount = debugger->getValidationLayersSize();
@@ -83,4 +94,6 @@ void LogicalDevice::setupQueues() {
 	uint32_t presentIndex = physicalDevice->getQueueFamilyIndices().present.value();
 	vkGetDeviceQueue(device, graphicIndex, 0, &graphicQueue);
 	vkGetDeviceQueue(device, presentIndex, 0, &presentQueue);
+	vkGetDeviceQueue(device, physicalDevice->getTransferQueueIndex(), 0, &transferQueue);
+	vkGetDeviceQueue(device, physicalDevice->getComputeQueueIndex(), 0, &computeQueue);
 }
\ No newline at end of file
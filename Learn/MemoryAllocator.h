@@ -0,0 +1,338 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <vector>
+#include "LogicalDevice.h"
+
+// Buffers and linear images never share a block with optimal-tiling images,
+// which keeps every suballocation clear of bufferImageGranularity conflicts.
+enum MemoryPoolType {
+	MEMORY_POOL_LINEAR = 0,
+	MEMORY_POOL_OPTIMAL = 1,
+	MEMORY_POOL_TYPE_COUNT = 2
+};
+
+const VkDeviceSize DEFAULT_MEMORY_BLOCK_SIZE = 64ull * 1024 * 1024;
+const VkDeviceSize MIN_MEMORY_ALLOCATION_SIZE = 256;
+
+struct MemoryBlock {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize size = 0;
+	void* mapped = nullptr;
+	uint32_t allocationCount = 0;
+	// Buddy free lists, one per order; order 0 is MIN_MEMORY_ALLOCATION_SIZE bytes.
+	std::vector<std::set<VkDeviceSize>> freeLists;
+};
+
+struct MemoryAllocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void* mapped = nullptr;
+	uint32_t memoryTypeIndex = 0;
+	MemoryPoolType poolType = MEMORY_POOL_LINEAR;
+	MemoryBlock* block = nullptr;
+	uint32_t order = 0;
+	bool dedicated = false;
+};
+
+struct MemoryPoolStatistics {
+	uint32_t blockCount = 0;
+	uint32_t allocationCount = 0;
+	uint32_t dedicatedCount = 0;
+	VkDeviceSize reservedBytes = 0;
+	VkDeviceSize usedBytes = 0;
+	VkDeviceSize requestedBytes = 0;
+	VkDeviceSize dedicatedBytes = 0;
+};
+
+class MemoryAllocator {
+public:
+	~MemoryAllocator();
+	MemoryAllocator(LogicalDevice* device);
+	MemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, MemoryPoolType poolType);
+	void free(MemoryAllocation& allocation);
+	void flush(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size);
+	MemoryPoolStatistics getStatistics(uint32_t memoryTypeIndex, MemoryPoolType poolType);
+	void printStatistics();
+
+private:
+	struct MemoryPool {
+		VkDeviceSize blockSize = 0;
+		uint32_t maxOrder = 0;
+		std::vector<MemoryBlock*> blocks;
+		MemoryPoolStatistics statistics;
+	};
+
+	void createPools();
+	MemoryBlock* createBlock(MemoryPool& pool, uint32_t memoryTypeIndex);
+	void destroyBlock(MemoryBlock* block);
+	MemoryAllocation allocateDedicated(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, MemoryPoolType poolType);
+	bool allocateFromBlock(MemoryBlock* block, uint32_t order, VkDeviceSize& offset);
+	void freeToBlock(MemoryBlock* block, VkDeviceSize offset, uint32_t order);
+	uint32_t retrieveOrder(VkDeviceSize size);
+	bool isHostVisible(uint32_t memoryTypeIndex);
+	bool isHostCoherent(uint32_t memoryTypeIndex);
+	MemoryPool& getPool(uint32_t memoryTypeIndex, MemoryPoolType poolType) { return pools[memoryTypeIndex * MEMORY_POOL_TYPE_COUNT + poolType]; }
+
+	LogicalDevice* device;
+	VkPhysicalDeviceMemoryProperties memProperties;
+	VkDeviceSize nonCoherentAtomSize;
+	std::vector<MemoryPool> pools;
+	std::mutex mutex;
+};
+
+MemoryAllocator::~MemoryAllocator() {
+	for (auto& pool : pools) {
+		for (auto block : pool.blocks)
+			destroyBlock(block);
+		pool.blocks.clear();
+	}
+}
+
+MemoryAllocator::MemoryAllocator(LogicalDevice* inDevice) {
+	device = inDevice;
+	memProperties = device->getPhysicalDevice()->getMemoryProperties();
+	nonCoherentAtomSize = device->getPhysicalDevice()->getProperties().limits.nonCoherentAtomSize;
+	createPools();
+}
+
+void MemoryAllocator::createPools() {
+	pools.resize(memProperties.memoryTypeCount * MEMORY_POOL_TYPE_COUNT);
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i) {
+		// Small heaps (e.g. the 256 MiB host-visible device-local heap) get proportionally smaller blocks.
+		VkDeviceSize heapSize = memProperties.memoryHeaps[memProperties.memoryTypes[i].heapIndex].size;
+		VkDeviceSize blockSize = DEFAULT_MEMORY_BLOCK_SIZE;
+		while (blockSize > MIN_MEMORY_ALLOCATION_SIZE && blockSize > heapSize / 8)
+			blockSize >>= 1;
+
+		for (uint32_t type = 0; type < MEMORY_POOL_TYPE_COUNT; ++type) {
+			MemoryPool& pool = getPool(i, static_cast<MemoryPoolType>(type));
+			pool.blockSize = blockSize;
+			pool.maxOrder = retrieveOrder(blockSize);
+		}
+	}
+}
+
+uint32_t MemoryAllocator::retrieveOrder(VkDeviceSize size) {
+	uint32_t order = 0;
+	while ((MIN_MEMORY_ALLOCATION_SIZE << order) < size)
+		order++;
+	return order;
+}
+
+bool MemoryAllocator::isHostVisible(uint32_t memoryTypeIndex) {
+	return memProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+}
+
+bool MemoryAllocator::isHostCoherent(uint32_t memoryTypeIndex) {
+	return memProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, MemoryPoolType poolType) {
+	uint32_t memoryTypeIndex = device->getPhysicalDevice()->retrieveMemoryTypeIndex(requirements.memoryTypeBits, properties);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	MemoryPool& pool = getPool(memoryTypeIndex, poolType);
+
+	// Buddy blocks are aligned to their own size, so rounding up to the alignment covers both constraints.
+	VkDeviceSize alignedSize = std::max(requirements.size, requirements.alignment);
+	if (alignedSize > pool.blockSize / 2)
+		return allocateDedicated(requirements, memoryTypeIndex, poolType);
+
+	uint32_t order = retrieveOrder(alignedSize);
+	VkDeviceSize offset = 0;
+	MemoryBlock* target = nullptr;
+	for (auto block : pool.blocks) {
+		if (allocateFromBlock(block, order, offset)) {
+			target = block;
+			break;
+		}
+	}
+	if (target == nullptr) {
+		target = createBlock(pool, memoryTypeIndex);
+		if (!allocateFromBlock(target, order, offset))
+			throw std::runtime_error("Failed to suballocate from a new memory block.");
+	}
+	target->allocationCount++;
+
+	MemoryAllocation allocation{};
+	allocation.memory = target->memory;
+	allocation.offset = offset;
+	allocation.size = requirements.size;
+	allocation.mapped = target->mapped ? static_cast<char*>(target->mapped) + offset : nullptr;
+	allocation.memoryTypeIndex = memoryTypeIndex;
+	allocation.poolType = poolType;
+	allocation.block = target;
+	allocation.order = order;
+
+	pool.statistics.allocationCount++;
+	pool.statistics.usedBytes += MIN_MEMORY_ALLOCATION_SIZE << order;
+	pool.statistics.requestedBytes += requirements.size;
+	return allocation;
+}
+
+MemoryAllocation MemoryAllocator::allocateDedicated(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, MemoryPoolType poolType) {
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = requirements.size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	MemoryAllocation allocation{};
+	if (vkAllocateMemory(device->getDevice(), &allocInfo, nullptr, &allocation.memory) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate dedicated memory.");
+	if (isHostVisible(memoryTypeIndex))
+		vkMapMemory(device->getDevice(), allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped);
+
+	allocation.size = requirements.size;
+	allocation.memoryTypeIndex = memoryTypeIndex;
+	allocation.poolType = poolType;
+	allocation.dedicated = true;
+
+	MemoryPoolStatistics& statistics = getPool(memoryTypeIndex, poolType).statistics;
+	statistics.dedicatedCount++;
+	statistics.dedicatedBytes += requirements.size;
+	return allocation;
+}
+
+MemoryBlock* MemoryAllocator::createBlock(MemoryPool& pool, uint32_t memoryTypeIndex) {
+	MemoryBlock* block = new MemoryBlock();
+	block->size = pool.blockSize;
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = block->size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	if (vkAllocateMemory(device->getDevice(), &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+		delete block;
+		throw std::runtime_error("Failed to allocate memory block.");
+	}
+	if (isHostVisible(memoryTypeIndex))
+		vkMapMemory(device->getDevice(), block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped);
+
+	block->freeLists.resize(pool.maxOrder + 1);
+	block->freeLists[pool.maxOrder].insert(0);
+	pool.blocks.push_back(block);
+
+	pool.statistics.blockCount++;
+	pool.statistics.reservedBytes += block->size;
+	return block;
+}
+
+void MemoryAllocator::destroyBlock(MemoryBlock* block) {
+	if (block->mapped)
+		vkUnmapMemory(device->getDevice(), block->memory);
+	vkFreeMemory(device->getDevice(), block->memory, nullptr);
+	delete block;
+}
+
+bool MemoryAllocator::allocateFromBlock(MemoryBlock* block, uint32_t order, VkDeviceSize& offset) {
+	uint32_t current = order;
+	while (current < block->freeLists.size() && block->freeLists[current].empty())
+		current++;
+	if (current >= block->freeLists.size())
+		return false;
+
+	offset = *block->freeLists[current].begin();
+	block->freeLists[current].erase(block->freeLists[current].begin());
+
+	// Split down to the requested order, keeping the upper halves free.
+	while (current > order) {
+		current--;
+		block->freeLists[current].insert(offset + (MIN_MEMORY_ALLOCATION_SIZE << current));
+	}
+	return true;
+}
+
+void MemoryAllocator::freeToBlock(MemoryBlock* block, VkDeviceSize offset, uint32_t order) {
+	while (order + 1 < block->freeLists.size()) {
+		VkDeviceSize buddy = offset ^ (MIN_MEMORY_ALLOCATION_SIZE << order);
+		auto it = block->freeLists[order].find(buddy);
+		if (it == block->freeLists[order].end())
+			break;
+		block->freeLists[order].erase(it);
+		offset = std::min(offset, buddy);
+		order++;
+	}
+	block->freeLists[order].insert(offset);
+}
+
+void MemoryAllocator::free(MemoryAllocation& allocation) {
+	if (allocation.memory == VK_NULL_HANDLE)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	MemoryPool& pool = getPool(allocation.memoryTypeIndex, allocation.poolType);
+
+	if (allocation.dedicated) {
+		if (allocation.mapped)
+			vkUnmapMemory(device->getDevice(), allocation.memory);
+		vkFreeMemory(device->getDevice(), allocation.memory, nullptr);
+		pool.statistics.dedicatedCount--;
+		pool.statistics.dedicatedBytes -= allocation.size;
+		allocation = MemoryAllocation{};
+		return;
+	}
+
+	MemoryBlock* block = allocation.block;
+	freeToBlock(block, allocation.offset, allocation.order);
+	block->allocationCount--;
+	pool.statistics.allocationCount--;
+	pool.statistics.usedBytes -= MIN_MEMORY_ALLOCATION_SIZE << allocation.order;
+	pool.statistics.requestedBytes -= allocation.size;
+
+	// Keep one empty block around so alternating alloc/free does not hit vkAllocateMemory every time.
+	if (block->allocationCount == 0 && pool.blocks.size() > 1) {
+		pool.blocks.erase(std::find(pool.blocks.begin(), pool.blocks.end(), block));
+		pool.statistics.blockCount--;
+		pool.statistics.reservedBytes -= block->size;
+		destroyBlock(block);
+	}
+	allocation = MemoryAllocation{};
+}
+
+void MemoryAllocator::flush(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) {
+	if (allocation.mapped == nullptr || isHostCoherent(allocation.memoryTypeIndex))
+		return;
+
+	VkDeviceSize memorySize = allocation.dedicated ? allocation.size : allocation.block->size;
+	VkDeviceSize begin = allocation.offset + offset;
+	VkDeviceSize end = (size == VK_WHOLE_SIZE) ? allocation.offset + allocation.size : begin + size;
+	begin = begin / nonCoherentAtomSize * nonCoherentAtomSize;
+	end = std::min((end + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize, memorySize);
+
+	VkMappedMemoryRange range{};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = allocation.memory;
+	range.offset = begin;
+	range.size = end - begin;
+	vkFlushMappedMemoryRanges(device->getDevice(), 1, &range);
+}
+
+MemoryPoolStatistics MemoryAllocator::getStatistics(uint32_t memoryTypeIndex, MemoryPoolType poolType) {
+	std::lock_guard<std::mutex> lock(mutex);
+	return getPool(memoryTypeIndex, poolType).statistics;
+}
+
+void MemoryAllocator::printStatistics() {
+	std::lock_guard<std::mutex> lock(mutex);
+	const char* poolNames[MEMORY_POOL_TYPE_COUNT] = { "linear", "optimal" };
+	std::cout << "Device memory pools:\n";
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i) {
+		for (uint32_t type = 0; type < MEMORY_POOL_TYPE_COUNT; ++type) {
+			MemoryPoolStatistics& statistics = getPool(i, static_cast<MemoryPoolType>(type)).statistics;
+			if (statistics.blockCount == 0 && statistics.dedicatedCount == 0)
+				continue;
+			std::cout << "  type " << i << " (" << poolNames[type] << "): "
+				<< statistics.blockCount << " blocks, "
+				<< statistics.allocationCount << " allocations, "
+				<< statistics.usedBytes / 1024 << " / " << statistics.reservedBytes / 1024 << " KiB used, "
+				<< statistics.requestedBytes / 1024 << " KiB requested, "
+				<< statistics.dedicatedCount << " dedicated (" << statistics.dedicatedBytes / 1024 << " KiB)\n";
+		}
+	}
+}
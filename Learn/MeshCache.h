@@ -0,0 +1,283 @@
+#pragma once
+
+#include <cfloat>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Hash.h"
+
+const uint32_t MESH_CACHE_MAGIC = 0x4853454D; // "MESH"
+const uint32_t MESH_CACHE_VERSION = 4;
+const uint64_t MESH_CACHE_SECTION_ALIGNMENT = 16;
+
+const uint32_t MESH_MAX_LODS = 4;
+
+/** @brief Index range of one level of detail, its geometric error in model units and the meshlets covering it */
+struct MeshLod {
+	uint32_t indexBase = 0;
+	uint32_t indexCount = 0;
+	float error = 0.0f;
+	// Filled in by MeshletBuilder once the index ranges are final
+	uint32_t meshletBase = 0;
+	uint32_t meshletCount = 0;
+};
+
+/** @brief Consecutive triangles of one LOD range with bounds for culling */
+struct Meshlet {
+	uint32_t indexBase;
+	uint32_t indexCount;
+	float sphere[4];	// center and radius
+	float cone[4];		// axis and cutoff, backfacing from everywhere the sphere is seen under the cutoff
+};
+
+/** @brief Vertex and index range of one mesh of a source file, relative to the start of that file's data */
+struct MeshPart {
+	uint32_t vertexBase;
+	uint32_t vertexCount;
+	uint32_t indexBase;
+	uint32_t indexCount;
+	// lods[0] is the full mesh above, coarser levels index into the same vertices
+	uint32_t lodCount;
+	MeshLod lods[MESH_MAX_LODS];
+};
+
+// Everything the renderer keeps from one imported source file. Indices are relative to the
+// file's first vertex so the data can be copied into a shared buffer without rebasing.
+struct MeshData {
+	std::vector<uint8_t> vertexData;	// vertices in the layout's stored formats
+	std::vector<uint32_t> indexData;
+	std::vector<MeshPart> parts;
+	std::vector<Meshlet> meshlets;
+	glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+	glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+};
+
+// Fixed-size header at the start of a cache file. Every section starts at an aligned offset
+// recorded here, so a mapped file can be handed to the uploader section by section.
+struct MeshCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sourceHash;
+	uint64_t settingsHash;
+	uint32_t vertexStride;
+	uint32_t partCount;
+	uint64_t vertexCount;
+	uint64_t indexCount;
+	uint64_t meshletCount;
+	uint64_t partsOffset;
+	uint64_t meshletsOffset;
+	uint64_t vertexDataOffset;
+	uint64_t indexDataOffset;
+	float boundsMin[3];
+	float boundsMax[3];
+};
+
+// Binary cache of an imported mesh stored next to its source as "<source>.<settings hash>.mesh".
+// An entry is only used when both the source contents and the import settings still match.
+class MeshCache {
+public:
+	MeshCache(const std::string& sourcePath, uint64_t settingsHash, uint32_t vertexStride);
+	bool load(MeshData& mesh);
+	bool loadBounds(glm::vec3& boundsMin, glm::vec3& boundsMax);
+	void store(const MeshData& mesh);
+
+private:
+	bool readHeader(std::ifstream& file, MeshCacheHeader& header);
+	bool areSectionsValid(const MeshCacheHeader& header, uint64_t fileSize);
+	bool areRangesValid(const MeshData& mesh);
+	void hashSource();
+	static bool isSectionValid(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t fileSize) {
+		return offset <= fileSize && count <= (fileSize - offset) / elementSize;
+	}
+	static uint64_t alignOffset(uint64_t offset) { return (offset + MESH_CACHE_SECTION_ALIGNMENT - 1) & ~(MESH_CACHE_SECTION_ALIGNMENT - 1); }
+
+	std::string sourcePath;
+	std::string cachePath;
+	uint64_t sourceHash = 0;
+	uint64_t settingsHash;
+	uint32_t vertexStride;
+	bool sourceHashed = false;
+	bool sourceFound = false;
+};
+
+MeshCache::MeshCache(const std::string& inSourcePath, uint64_t inSettingsHash, uint32_t inVertexStride) {
+	sourcePath = inSourcePath;
+	settingsHash = inSettingsHash;
+	vertexStride = inVertexStride;
+
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".%016llx.mesh", static_cast<unsigned long long>(settingsHash));
+	cachePath = sourcePath + suffix;
+}
+
+void MeshCache::hashSource() {
+	// Reading the whole source is only worth it when the cache is actually loaded or stored.
+	if (sourceHashed)
+		return;
+	sourceHashed = true;
+	std::ifstream file(sourcePath, std::ios::binary);
+	if (!file.is_open())
+		return;
+	std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	sourceHash = hashBytes(contents.data(), contents.size());
+	sourceFound = true;
+}
+
+bool MeshCache::readHeader(std::ifstream& file, MeshCacheHeader& header) {
+	if (!file.is_open() || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+		return false;
+	return header.magic == MESH_CACHE_MAGIC && header.version == MESH_CACHE_VERSION &&
+		header.settingsHash == settingsHash && header.vertexStride == vertexStride;
+}
+
+bool MeshCache::loadBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) {
+	// Header only and without hashing the source: the bounds of an outdated entry are still a fine placeholder.
+	std::ifstream file(cachePath, std::ios::binary);
+	MeshCacheHeader header{};
+	if (!readHeader(file, header) || header.partCount == 0)
+		return false;
+	boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+	return true;
+}
+
+bool MeshCache::load(MeshData& mesh) {
+	hashSource();
+	if (!sourceFound)
+		return false;
+	std::ifstream file(cachePath, std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	MeshCacheHeader header{};
+	if (!readHeader(file, header) || header.sourceHash != sourceHash) {
+		std::cout << "Mesh cache " << cachePath << " is stale, re-importing.\n";
+		return false;
+	}
+
+	// The header matching does not make the rest of the file intact, so nothing in it is trusted before it is checked.
+	file.seekg(0, std::ios::end);
+	uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+	if (!areSectionsValid(header, fileSize)) {
+		std::cerr << "Mesh cache " << cachePath << " is truncated, re-importing.\n";
+		return false;
+	}
+
+	mesh.parts.resize(header.partCount);
+	mesh.meshlets.resize(static_cast<size_t>(header.meshletCount));
+	mesh.vertexData.resize(static_cast<size_t>(header.vertexCount * vertexStride));
+	mesh.indexData.resize(static_cast<size_t>(header.indexCount));
+
+	bool complete =
+		file.seekg(header.partsOffset).read(reinterpret_cast<char*>(mesh.parts.data()), mesh.parts.size() * sizeof(MeshPart)) &&
+		file.seekg(header.meshletsOffset).read(reinterpret_cast<char*>(mesh.meshlets.data()), mesh.meshlets.size() * sizeof(Meshlet)) &&
+		file.seekg(header.vertexDataOffset).read(reinterpret_cast<char*>(mesh.vertexData.data()), mesh.vertexData.size()) &&
+		file.seekg(header.indexDataOffset).read(reinterpret_cast<char*>(mesh.indexData.data()), mesh.indexData.size() * sizeof(uint32_t));
+	if (!complete) {
+		std::cerr << "Mesh cache " << cachePath << " is truncated, re-importing.\n";
+		mesh = MeshData();
+		return false;
+	}
+	if (!areRangesValid(mesh)) {
+		std::cerr << "Mesh cache " << cachePath << " is damaged, re-importing.\n";
+		mesh = MeshData();
+		return false;
+	}
+
+	mesh.boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	mesh.boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+	return true;
+}
+
+bool MeshCache::areSectionsValid(const MeshCacheHeader& header, uint64_t fileSize) {
+	return isSectionValid(header.partsOffset, header.partCount, sizeof(MeshPart), fileSize) &&
+		isSectionValid(header.meshletsOffset, header.meshletCount, sizeof(Meshlet), fileSize) &&
+		isSectionValid(header.vertexDataOffset, header.vertexCount, vertexStride, fileSize) &&
+		isSectionValid(header.indexDataOffset, header.indexCount, sizeof(uint32_t), fileSize);
+}
+
+bool MeshCache::areRangesValid(const MeshData& mesh) {
+	// Every range has to lie within the data it points into, and every index within its part's vertices.
+	uint64_t vertexCount = mesh.vertexData.size() / vertexStride;
+	for (const MeshPart& part : mesh.parts) {
+		if (static_cast<uint64_t>(part.vertexBase) + part.vertexCount > vertexCount ||
+			static_cast<uint64_t>(part.indexBase) + part.indexCount > mesh.indexData.size() ||
+			part.lodCount == 0 || part.lodCount > MESH_MAX_LODS)
+			return false;
+		for (uint32_t level = 0; level < part.lodCount; ++level) {
+			const MeshLod& lod = part.lods[level];
+			if (static_cast<uint64_t>(lod.indexBase) + lod.indexCount > mesh.indexData.size() ||
+				static_cast<uint64_t>(lod.meshletBase) + lod.meshletCount > mesh.meshlets.size())
+				return false;
+			for (uint32_t i = lod.indexBase; i < lod.indexBase + lod.indexCount; ++i)
+				if (mesh.indexData[i] < part.vertexBase || mesh.indexData[i] - part.vertexBase >= part.vertexCount)
+					return false;
+			for (uint32_t m = lod.meshletBase; m < lod.meshletBase + lod.meshletCount; ++m) {
+				const Meshlet& meshlet = mesh.meshlets[m];
+				if (meshlet.indexBase < lod.indexBase ||
+					static_cast<uint64_t>(meshlet.indexBase) + meshlet.indexCount > static_cast<uint64_t>(lod.indexBase) + lod.indexCount)
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+void MeshCache::store(const MeshData& mesh) {
+	hashSource();
+	if (!sourceFound)
+		return;
+
+	MeshCacheHeader header{};
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.settingsHash = settingsHash;
+	header.vertexStride = vertexStride;
+	header.partCount = static_cast<uint32_t>(mesh.parts.size());
+	header.vertexCount = mesh.vertexData.size() / vertexStride;
+	header.indexCount = mesh.indexData.size();
+	header.meshletCount = mesh.meshlets.size();
+	header.partsOffset = alignOffset(sizeof(MeshCacheHeader));
+	header.meshletsOffset = alignOffset(header.partsOffset + mesh.parts.size() * sizeof(MeshPart));
+	header.vertexDataOffset = alignOffset(header.meshletsOffset + mesh.meshlets.size() * sizeof(Meshlet));
+	header.indexDataOffset = alignOffset(header.vertexDataOffset + mesh.vertexData.size());
+	for (int i = 0; i < 3; ++i) {
+		header.boundsMin[i] = mesh.boundsMin[i];
+		header.boundsMax[i] = mesh.boundsMax[i];
+	}
+
+	// Same temp-file-and-rename scheme as the pipeline cache, so readers never see a partial entry.
+	std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		const char padding[MESH_CACHE_SECTION_ALIGNMENT] = {};
+		auto pad = [&](uint64_t offset) {
+			uint64_t position = static_cast<uint64_t>(file.tellp());
+			file.write(padding, static_cast<std::streamsize>(offset - position));
+		};
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		pad(header.partsOffset);
+		file.write(reinterpret_cast<const char*>(mesh.parts.data()), mesh.parts.size() * sizeof(MeshPart));
+		pad(header.meshletsOffset);
+		file.write(reinterpret_cast<const char*>(mesh.meshlets.data()), mesh.meshlets.size() * sizeof(Meshlet));
+		pad(header.vertexDataOffset);
+		file.write(reinterpret_cast<const char*>(mesh.vertexData.data()), mesh.vertexData.size());
+		pad(header.indexDataOffset);
+		file.write(reinterpret_cast<const char*>(mesh.indexData.data()), mesh.indexData.size() * sizeof(uint32_t));
+		if (!file) {
+			std::cerr << "Failed to write mesh cache " << tempPath << ".\n";
+			return;
+		}
+	}
+	std::remove(cachePath.c_str());
+	if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+		std::cerr << "Failed to replace mesh cache " << cachePath << ".\n";
+}
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "MeshCache.h"
+
+// Post-transform cache size the triangle order is tuned for and the statistics are measured against.
+const uint32_t VERTEX_CACHE_SIZE = 16;
+
+/** @brief Misses of a FIFO vertex cache, reported per triangle (ACMR) and per referenced vertex (ATVR) */
+struct VertexCacheStatistics {
+	uint64_t misses = 0;
+	uint64_t triangles = 0;
+	uint64_t vertices = 0;
+
+	float acmr() const { return triangles ? static_cast<float>(misses) / triangles : 0.0f; }
+	float atvr() const { return vertices ? static_cast<float>(misses) / vertices : 0.0f; }
+	void add(const VertexCacheStatistics& other) {
+		misses += other.misses;
+		triangles += other.triangles;
+		vertices += other.vertices;
+	}
+};
+
+/** @brief Vertex cache behaviour of a mesh before and after its optimization */
+struct MeshOptimizationStatistics {
+	VertexCacheStatistics before;
+	VertexCacheStatistics after;
+};
+
+// Reorders every part of an imported mesh for the GPU:
+// Tipsify triangle order for the post-transform cache, an overdraw-aware reorder of the
+// resulting clusters and finally vertices renumbered into first-use order for fetch locality.
+class MeshOptimizer {
+public:
+	// Vertices are opaque bytes to the optimizer, the readers decode a position or normal from the start of a vertex.
+	using VertexReader = std::function<glm::vec3(const uint8_t*)>;
+
+	MeshOptimizer(uint32_t vertexStride, VertexReader readPosition, VertexReader readNormal = nullptr);
+	MeshOptimizationStatistics optimize(MeshData& mesh);
+	void optimizeTriangleOrder(const uint8_t* vertices, std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+	static VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+private:
+	std::vector<uint32_t> getLocalIndices(const MeshData& mesh, const MeshPart& part);
+	void optimizePart(MeshData& mesh, const MeshPart& part);
+	std::vector<uint32_t> tipsify(const std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<size_t>& clusters);
+	void reorderClusters(const uint8_t* vertices, std::vector<uint32_t>& indices, const std::vector<size_t>& clusters);
+	void reorderVertices(uint8_t* vertices, std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+	glm::vec3 getPosition(const uint8_t* vertices, uint32_t vertex) { return readPosition(vertices + static_cast<size_t>(vertex) * vertexStride); }
+	glm::vec3 getNormal(const uint8_t* vertices, uint32_t vertex) { return readNormal(vertices + static_cast<size_t>(vertex) * vertexStride); }
+
+	uint32_t vertexStride;
+	VertexReader readPosition;
+	VertexReader readNormal;
+};
+
+MeshOptimizer::MeshOptimizer(uint32_t inVertexStride, VertexReader inReadPosition, VertexReader inReadNormal) {
+	vertexStride = inVertexStride;
+	readPosition = inReadPosition;
+	readNormal = inReadNormal;
+}
+
+MeshOptimizationStatistics MeshOptimizer::optimize(MeshData& mesh) {
+	MeshOptimizationStatistics statistics;
+	for (auto& part : mesh.parts) {
+		std::vector<uint32_t> indices = getLocalIndices(mesh, part);
+		statistics.before.add(analyzeVertexCache(indices.data(), indices.size(), part.vertexCount));
+		optimizePart(mesh, part);
+		indices = getLocalIndices(mesh, part);
+		statistics.after.add(analyzeVertexCache(indices.data(), indices.size(), part.vertexCount));
+	}
+	return statistics;
+}
+
+VertexCacheStatistics MeshOptimizer::analyzeVertexCache(const uint32_t* indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize) {
+	VertexCacheStatistics statistics;
+	if (indexCount < 3)
+		return statistics;
+
+	// FIFO cache: an index hits while fewer than cacheSize misses happened since it was loaded.
+	std::vector<uint64_t> loadedAt(vertexCount, 0);
+	std::vector<bool> referenced(vertexCount, false);
+	uint64_t& misses = statistics.misses;
+	for (size_t i = 0; i < indexCount; ++i) {
+		uint32_t vertex = indices[i];
+		if (loadedAt[vertex] == 0 || misses - loadedAt[vertex] + 1 > cacheSize) {
+			misses++;
+			loadedAt[vertex] = misses;
+		}
+		if (!referenced[vertex]) {
+			referenced[vertex] = true;
+			statistics.vertices++;
+		}
+	}
+	statistics.triangles = indexCount / 3;
+	return statistics;
+}
+
+std::vector<uint32_t> MeshOptimizer::getLocalIndices(const MeshData& mesh, const MeshPart& part) {
+	// Stored indices are relative to the file, the passes work relative to the part.
+	std::vector<uint32_t> indices(part.indexCount);
+	for (uint32_t i = 0; i < part.indexCount; ++i)
+		indices[i] = mesh.indexData[part.indexBase + i] - part.vertexBase;
+	return indices;
+}
+
+void MeshOptimizer::optimizePart(MeshData& mesh, const MeshPart& part) {
+	if (part.indexCount < 3 || part.vertexCount == 0)
+		return;
+
+	std::vector<uint32_t> indices = getLocalIndices(mesh, part);
+	uint8_t* vertices = mesh.vertexData.data() + static_cast<size_t>(part.vertexBase) * vertexStride;
+	optimizeTriangleOrder(vertices, indices, part.vertexCount);
+	reorderVertices(vertices, indices, part.vertexCount);
+
+	for (uint32_t i = 0; i < part.indexCount; ++i)
+		mesh.indexData[part.indexBase + i] = indices[i] + part.vertexBase;
+}
+
+void MeshOptimizer::optimizeTriangleOrder(const uint8_t* vertices, std::vector<uint32_t>& indices, uint32_t vertexCount) {
+	if (indices.size() < 3)
+		return;
+	std::vector<size_t> clusters;
+	indices = tipsify(indices, vertexCount, clusters);
+	reorderClusters(vertices, indices, clusters);
+}
+
+std::vector<uint32_t> MeshOptimizer::tipsify(const std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<size_t>& clusters) {
+	// Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007.
+	size_t triangleCount = indices.size() / 3;
+
+	// Vertex to triangle adjacency in compressed rows.
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+	for (uint32_t index : indices)
+		liveTriangles[index]++;
+	std::vector<size_t> adjacencyOffset(vertexCount + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<size_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	for (size_t i = 0; i < indices.size(); ++i)
+		adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+	std::vector<uint64_t> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	uint64_t timestamp = VERTEX_CACHE_SIZE + 1;
+	uint32_t cursor = 0;
+	int64_t fanning = 0;
+	clusters.clear();
+	clusters.push_back(0);
+
+	auto skipDeadEnd = [&]() -> int64_t {
+		while (!deadEnds.empty()) {
+			uint32_t vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[vertex] > 0)
+				return vertex;
+		}
+		while (cursor < vertexCount) {
+			if (liveTriangles[cursor] > 0)
+				return cursor;
+			cursor++;
+		}
+		return -1;
+	};
+
+	while (fanning >= 0) {
+		candidates.clear();
+		for (size_t a = adjacencyOffset[fanning]; a < adjacencyOffset[fanning + 1]; ++a) {
+			uint32_t triangle = adjacency[a];
+			if (emitted[triangle])
+				continue;
+			for (int corner = 0; corner < 3; ++corner) {
+				uint32_t vertex = indices[triangle * 3 + corner];
+				output.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+				if (timestamp - cacheTime[vertex] > VERTEX_CACHE_SIZE)
+					cacheTime[vertex] = timestamp++;
+			}
+			emitted[triangle] = true;
+		}
+
+		// Prefer the candidate that stays in the cache longest while its remaining triangles are emitted.
+		int64_t next = -1;
+		int64_t bestPriority = -1;
+		for (uint32_t vertex : candidates) {
+			if (liveTriangles[vertex] == 0)
+				continue;
+			int64_t priority = 0;
+			if (timestamp - cacheTime[vertex] + 2 * liveTriangles[vertex] <= VERTEX_CACHE_SIZE)
+				priority = static_cast<int64_t>(timestamp - cacheTime[vertex]);
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = vertex;
+			}
+		}
+
+		// A dead end breaks cache locality anyway, which makes it a free cluster boundary for the overdraw pass.
+		if (next < 0) {
+			next = skipDeadEnd();
+			if (output.size() / 3 > clusters.back())
+				clusters.push_back(output.size() / 3);
+		}
+		fanning = next;
+	}
+	return output;
+}
+
+void MeshOptimizer::reorderClusters(const uint8_t* vertices, std::vector<uint32_t>& indices, const std::vector<size_t>& clusters) {
+	size_t triangleCount = indices.size() / 3;
+	if (clusters.size() < 2)
+		return;
+
+	struct Cluster {
+		size_t begin;
+		size_t end;
+		float sortKey;
+	};
+	std::vector<Cluster> sorted;
+	std::vector<glm::vec3> centroids;
+	std::vector<glm::vec3> normals;
+
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusters.size(); ++c) {
+		size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+		glm::vec3 centroid(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (size_t t = clusters[c]; t < end; ++t) {
+			glm::vec3 p0 = getPosition(vertices, indices[t * 3 + 0]);
+			glm::vec3 p1 = getPosition(vertices, indices[t * 3 + 1]);
+			glm::vec3 p2 = getPosition(vertices, indices[t * 3 + 2]);
+			float triangleArea = glm::length(glm::cross(p1 - p0, p2 - p0)) * 0.5f;
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			area += triangleArea;
+
+			// Winding is flipped on import, so the imported normals give the outward direction.
+			if (readNormal) {
+				for (int corner = 0; corner < 3; ++corner)
+					normal += getNormal(vertices, indices[t * 3 + corner]) * triangleArea;
+			}
+			else {
+				normal += glm::cross(p1 - p0, p2 - p0);
+			}
+		}
+		meshCentroid += centroid;
+		meshArea += area;
+		centroids.push_back(area > 0.0f ? centroid / area : centroid);
+		normals.push_back(normal);
+		sorted.push_back({ clusters[c], end, 0.0f });
+	}
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	// Clusters facing away from the centre are likely to occlude the others, so they are drawn first.
+	for (size_t c = 0; c < sorted.size(); ++c) {
+		float length = glm::length(normals[c]);
+		sorted[c].sortKey = length > 0.0f ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.0f;
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<uint32_t> reordered;
+	reordered.reserve(indices.size());
+	for (auto& cluster : sorted)
+		reordered.insert(reordered.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+	indices.swap(reordered);
+}
+
+void MeshOptimizer::reorderVertices(uint8_t* vertices, std::vector<uint32_t>& indices, uint32_t vertexCount) {
+	const uint32_t unused = ~0u;
+	std::vector<uint32_t> remap(vertexCount, unused);
+	uint32_t nextVertex = 0;
+	for (auto& index : indices) {
+		if (remap[index] == unused)
+			remap[index] = nextVertex++;
+		index = remap[index];
+	}
+	// Unreferenced vertices keep their relative order behind the used ones so the part size does not change.
+	for (auto& slot : remap)
+		if (slot == unused)
+			slot = nextVertex++;
+
+	std::vector<uint8_t> reordered(static_cast<size_t>(vertexCount) * vertexStride);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		memcpy(reordered.data() + static_cast<size_t>(remap[v]) * vertexStride, vertices + static_cast<size_t>(v) * vertexStride, vertexStride);
+	std::copy(reordered.begin(), reordered.end(), vertices);
+}
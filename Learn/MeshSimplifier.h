@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+
+// Every LOD aims for this fraction of the previous level's triangles and is dropped
+// when it keeps more than LOD_MIN_REDUCTION of them, i.e. the mesh no longer simplifies.
+const float LOD_TRIANGLE_RATIO = 0.5f;
+const float LOD_MIN_REDUCTION = 0.9f;
+
+// Quadric error metric simplification (Garland and Heckbert 1997) by half-edge collapse.
+// Vertices only ever collapse onto other existing vertices, so every LOD shares the vertex
+// buffer of the full mesh and only adds an index range.
+// Vertices on open edges never move. UV and normal seams are split vertices and therefore
+// open edges as well, so seams and mesh borders keep their shape.
+class MeshSimplifier {
+public:
+	MeshSimplifier(uint32_t vertexStride, MeshOptimizer::VertexReader readPosition);
+	void generateLods(MeshData& mesh, MeshOptimizer* optimizer = nullptr);
+	std::vector<uint32_t> simplify(const uint8_t* vertices, uint32_t vertexCount, const std::vector<uint32_t>& indices, size_t targetIndexCount, float& error);
+
+private:
+	// Symmetric 4x4 matrix of the summed squared plane distances.
+	struct Quadric {
+		double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+		void addPlane(const glm::vec3& normal, float distance);
+		void add(const Quadric& other);
+		double evaluate(const glm::vec3& p) const;
+	};
+
+	struct Collapse {
+		uint32_t from;
+		uint32_t to;
+		double cost;
+	};
+
+	std::vector<bool> findOpenEdgeVertices(const std::vector<uint32_t>& indices, uint32_t vertexCount);
+	bool flipsTriangle(const std::vector<glm::vec3>& positions, const uint32_t* triangle, uint32_t from, uint32_t to);
+
+	uint32_t vertexStride;
+	MeshOptimizer::VertexReader readPosition;
+};
+
+void MeshSimplifier::Quadric::addPlane(const glm::vec3& n, float d) {
+	a2 += n.x * n.x; ab += n.x * n.y; ac += n.x * n.z; ad += n.x * d;
+	b2 += n.y * n.y; bc += n.y * n.z; bd += n.y * d;
+	c2 += n.z * n.z; cd += n.z * d;
+	d2 += d * d;
+}
+
+void MeshSimplifier::Quadric::add(const Quadric& o) {
+	a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+	b2 += o.b2; bc += o.bc; bd += o.bd;
+	c2 += o.c2; cd += o.cd;
+	d2 += o.d2;
+}
+
+double MeshSimplifier::Quadric::evaluate(const glm::vec3& p) const {
+	double x = p.x, y = p.y, z = p.z;
+	return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+		+ b2 * y * y + 2 * bc * y * z + 2 * bd * y
+		+ c2 * z * z + 2 * cd * z
+		+ d2;
+}
+
+MeshSimplifier::MeshSimplifier(uint32_t inVertexStride, MeshOptimizer::VertexReader inReadPosition) {
+	vertexStride = inVertexStride;
+	readPosition = inReadPosition;
+}
+
+void MeshSimplifier::generateLods(MeshData& mesh, MeshOptimizer* optimizer) {
+	// Level k of every part is appended before level k + 1, so one LOD of the whole file is a single index range.
+	std::vector<std::vector<uint32_t>> previous(mesh.parts.size());
+	size_t previousTotal = 0;
+	for (size_t p = 0; p < mesh.parts.size(); ++p) {
+		MeshPart& part = mesh.parts[p];
+		part.lodCount = 1;
+		part.lods[0] = { part.indexBase, part.indexCount, 0.0f };
+		for (uint32_t i = 0; i < part.indexCount; ++i)
+			previous[p].push_back(mesh.indexData[part.indexBase + i] - part.vertexBase);
+		previousTotal += part.indexCount;
+	}
+
+	for (uint32_t level = 1; level < MESH_MAX_LODS; ++level) {
+		std::vector<std::vector<uint32_t>> next(mesh.parts.size());
+		std::vector<float> errors(mesh.parts.size());
+		size_t nextTotal = 0;
+		for (size_t p = 0; p < mesh.parts.size(); ++p) {
+			MeshPart& part = mesh.parts[p];
+			size_t target = static_cast<size_t>(previous[p].size() / 3 * LOD_TRIANGLE_RATIO) * 3;
+			const uint8_t* vertices = mesh.vertexData.data() + static_cast<size_t>(part.vertexBase) * vertexStride;
+			float error = 0.0f;
+			next[p] = simplify(vertices, part.vertexCount, previous[p], target, error);
+			// Each level is simplified from the previous one, so the errors add up.
+			errors[p] = part.lods[level - 1].error + error;
+			nextTotal += next[p].size();
+		}
+		if (nextTotal > previousTotal * LOD_MIN_REDUCTION)
+			break;
+
+		for (size_t p = 0; p < mesh.parts.size(); ++p) {
+			MeshPart& part = mesh.parts[p];
+			if (optimizer)
+				optimizer->optimizeTriangleOrder(mesh.vertexData.data() + static_cast<size_t>(part.vertexBase) * vertexStride, next[p], part.vertexCount);
+			part.lods[level] = { static_cast<uint32_t>(mesh.indexData.size()), static_cast<uint32_t>(next[p].size()), errors[p] };
+			part.lodCount = level + 1;
+			for (uint32_t index : next[p])
+				mesh.indexData.push_back(index + part.vertexBase);
+		}
+		previous.swap(next);
+		previousTotal = nextTotal;
+	}
+}
+
+std::vector<bool> MeshSimplifier::findOpenEdgeVertices(const std::vector<uint32_t>& indices, uint32_t vertexCount) {
+	// An edge used by anything other than exactly two triangles is a border, a seam or non-manifold.
+	std::unordered_map<uint64_t, uint32_t> edgeUses;
+	edgeUses.reserve(indices.size());
+	for (size_t t = 0; t < indices.size(); t += 3) {
+		for (int corner = 0; corner < 3; ++corner) {
+			uint32_t a = indices[t + corner];
+			uint32_t b = indices[t + (corner + 1) % 3];
+			edgeUses[static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b)]++;
+		}
+	}
+	std::vector<bool> open(vertexCount, false);
+	for (auto& edge : edgeUses) {
+		if (edge.second != 2) {
+			open[static_cast<uint32_t>(edge.first >> 32)] = true;
+			open[static_cast<uint32_t>(edge.first)] = true;
+		}
+	}
+	return open;
+}
+
+bool MeshSimplifier::flipsTriangle(const std::vector<glm::vec3>& positions, const uint32_t* triangle, uint32_t from, uint32_t to) {
+	glm::vec3 before[3], after[3];
+	for (int corner = 0; corner < 3; ++corner) {
+		before[corner] = positions[triangle[corner]];
+		after[corner] = triangle[corner] == from ? positions[to] : before[corner];
+	}
+	glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+	glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+	return glm::dot(normalBefore, normalAfter) <= 0.0f;
+}
+
+std::vector<uint32_t> MeshSimplifier::simplify(const uint8_t* vertices, uint32_t vertexCount, const std::vector<uint32_t>& input, size_t targetIndexCount, float& error) {
+	std::vector<uint32_t> indices = input;
+	error = 0.0f;
+	if (indices.size() <= targetIndexCount)
+		return indices;
+
+	std::vector<glm::vec3> positions(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		positions[v] = readPosition(vertices + static_cast<size_t>(v) * vertexStride);
+
+	std::vector<bool> locked = findOpenEdgeVertices(indices, vertexCount);
+
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t t = 0; t < indices.size(); t += 3) {
+		glm::vec3 p0 = positions[indices[t]], p1 = positions[indices[t + 1]], p2 = positions[indices[t + 2]];
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(normal);
+		if (length == 0.0f)
+			continue;
+		normal /= length;
+		for (int corner = 0; corner < 3; ++corner)
+			quadrics[indices[t + corner]].addPlane(normal, -glm::dot(normal, p0));
+	}
+
+	double maxCost = 0.0;
+	std::vector<Collapse> collapses;
+	std::vector<size_t> adjacencyOffset(vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<bool> touched(vertexCount);
+	std::vector<uint32_t> remap(vertexCount);
+
+	// Each pass collapses the cheapest independent edges, then rebuilds the index list.
+	while (indices.size() > targetIndexCount) {
+		collapses.clear();
+		for (size_t t = 0; t < indices.size(); t += 3) {
+			for (int corner = 0; corner < 3; ++corner) {
+				uint32_t a = indices[t + corner];
+				uint32_t b = indices[t + (corner + 1) % 3];
+				Quadric combined = quadrics[a];
+				combined.add(quadrics[b]);
+				if (!locked[a])
+					collapses.push_back({ a, b, combined.evaluate(positions[b]) });
+				if (!locked[b])
+					collapses.push_back({ b, a, combined.evaluate(positions[a]) });
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+		std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+		for (uint32_t index : indices)
+			adjacencyOffset[index + 1]++;
+		for (uint32_t v = 0; v < vertexCount; ++v)
+			adjacencyOffset[v + 1] += adjacencyOffset[v];
+		adjacency.resize(indices.size());
+		std::vector<size_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+		for (size_t i = 0; i < indices.size(); ++i)
+			adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+		std::fill(touched.begin(), touched.end(), false);
+		for (uint32_t v = 0; v < vertexCount; ++v)
+			remap[v] = v;
+
+		// An interior collapse removes two triangles, stop once the target would be reached.
+		size_t trianglesToRemove = (indices.size() - targetIndexCount) / 3;
+		size_t removed = 0;
+		for (auto& collapse : collapses) {
+			if (removed >= trianglesToRemove)
+				break;
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			bool valid = true;
+			for (size_t a = adjacencyOffset[collapse.from]; a < adjacencyOffset[collapse.from + 1] && valid; ++a) {
+				const uint32_t* triangle = &indices[adjacency[a] * 3];
+				bool shared = triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to;
+				if (!shared && flipsTriangle(positions, triangle, collapse.from, collapse.to))
+					valid = false;
+			}
+			if (!valid)
+				continue;
+
+			// Neighbours are frozen for the rest of the pass, their flip checks assumed the old position.
+			for (size_t a = adjacencyOffset[collapse.from]; a < adjacencyOffset[collapse.from + 1]; ++a)
+				for (int corner = 0; corner < 3; ++corner)
+					touched[indices[adjacency[a] * 3 + corner]] = true;
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].add(quadrics[collapse.from]);
+			maxCost = std::max(maxCost, collapse.cost);
+			removed += 2;
+		}
+		if (removed == 0)
+			break;
+
+		size_t write = 0;
+		for (size_t t = 0; t < indices.size(); t += 3) {
+			uint32_t a = remap[indices[t]], b = remap[indices[t + 1]], c = remap[indices[t + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			indices[write++] = a;
+			indices[write++] = b;
+			indices[write++] = c;
+		}
+		indices.resize(write);
+	}
+
+	// The summed squared plane distances are reported as a distance.
+	error = static_cast<float>(std::sqrt(maxCost));
+	return indices;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+// Written as the cone cutoff of meshlets whose normals spread too far to ever be backfacing as a whole.
+const float MESHLET_CONE_DISABLED = 2.0f;
+
+// Splits every LOD range of every part into meshlets of consecutive triangles.
+// The ranges are already in vertex cache order, so consecutive triangles are also spatially close.
+// Meshlets are emitted level by level like the index ranges, so the meshlets of one LOD of a file are contiguous too.
+class MeshletBuilder {
+public:
+	MeshletBuilder(uint32_t vertexStride, MeshOptimizer::VertexReader readPosition, MeshOptimizer::VertexReader readNormal = nullptr);
+	void buildMeshlets(MeshData& mesh);
+
+private:
+	void buildRange(MeshData& mesh, MeshLod& lod, float orientation);
+	void appendMeshlet(MeshData& mesh, uint32_t indexBase, uint32_t indexCount, float orientation);
+	float findOrientation(const MeshData& mesh, const MeshPart& part);
+	glm::vec3 getPosition(const MeshData& mesh, uint32_t vertex) { return readPosition(mesh.vertexData.data() + static_cast<size_t>(vertex) * vertexStride); }
+
+	uint32_t vertexStride;
+	MeshOptimizer::VertexReader readPosition;
+	MeshOptimizer::VertexReader readNormal;
+	std::vector<uint32_t> vertexStamp;
+	uint32_t stamp = 0;
+};
+
+MeshletBuilder::MeshletBuilder(uint32_t inVertexStride, MeshOptimizer::VertexReader inReadPosition, MeshOptimizer::VertexReader inReadNormal) {
+	vertexStride = inVertexStride;
+	readPosition = inReadPosition;
+	readNormal = inReadNormal;
+}
+
+void MeshletBuilder::buildMeshlets(MeshData& mesh) {
+	mesh.meshlets.clear();
+	vertexStamp.assign(mesh.vertexData.size() / vertexStride, 0);
+	stamp = 0;
+
+	std::vector<float> orientations;
+	uint32_t lodCount = 0;
+	for (auto& part : mesh.parts) {
+		orientations.push_back(findOrientation(mesh, part));
+		lodCount = std::max(lodCount, part.lodCount);
+	}
+
+	for (uint32_t level = 0; level < lodCount; ++level)
+		for (size_t p = 0; p < mesh.parts.size(); ++p)
+			if (level < mesh.parts[p].lodCount)
+				buildRange(mesh, mesh.parts[p].lods[level], orientations[p]);
+}
+
+float MeshletBuilder::findOrientation(const MeshData& mesh, const MeshPart& part) {
+	// Cone culling has to agree with the rasterizer about which side is the front. The imported
+	// normals face outwards, so the winding is taken as front facing when its normals agree with them.
+	if (!readNormal)
+		return 1.0f;
+	double agreement = 0.0;
+	for (uint32_t i = 0; i + 2 < part.indexCount; i += 3) {
+		const uint32_t* triangle = &mesh.indexData[part.indexBase + i];
+		glm::vec3 p0 = getPosition(mesh, triangle[0]), p1 = getPosition(mesh, triangle[1]), p2 = getPosition(mesh, triangle[2]);
+		glm::vec3 normal(0.0f);
+		for (int corner = 0; corner < 3; ++corner)
+			normal += readNormal(mesh.vertexData.data() + static_cast<size_t>(triangle[corner]) * vertexStride);
+		agreement += glm::dot(glm::cross(p1 - p0, p2 - p0), normal);
+	}
+	return agreement < 0.0 ? -1.0f : 1.0f;
+}
+
+void MeshletBuilder::buildRange(MeshData& mesh, MeshLod& lod, float orientation) {
+	lod.meshletBase = static_cast<uint32_t>(mesh.meshlets.size());
+	uint32_t begin = lod.indexBase;
+	uint32_t end = lod.indexBase + lod.indexCount;
+	uint32_t meshletBegin = begin;
+	uint32_t vertexCount = 0;
+	stamp++;
+
+	for (uint32_t i = begin; i < end; i += 3) {
+		uint32_t newVertices = 0;
+		for (int corner = 0; corner < 3; ++corner)
+			if (vertexStamp[mesh.indexData[i + corner]] != stamp)
+				newVertices++;
+
+		if (vertexCount + newVertices > MESHLET_MAX_VERTICES || (i - meshletBegin) / 3 == MESHLET_MAX_TRIANGLES) {
+			appendMeshlet(mesh, meshletBegin, i - meshletBegin, orientation);
+			meshletBegin = i;
+			vertexCount = 0;
+			stamp++;
+		}
+		for (int corner = 0; corner < 3; ++corner) {
+			uint32_t vertex = mesh.indexData[i + corner];
+			if (vertexStamp[vertex] != stamp) {
+				vertexStamp[vertex] = stamp;
+				vertexCount++;
+			}
+		}
+	}
+	if (end > meshletBegin)
+		appendMeshlet(mesh, meshletBegin, end - meshletBegin, orientation);
+	lod.meshletCount = static_cast<uint32_t>(mesh.meshlets.size()) - lod.meshletBase;
+}
+
+void MeshletBuilder::appendMeshlet(MeshData& mesh, uint32_t indexBase, uint32_t indexCount, float orientation) {
+	Meshlet meshlet{};
+	meshlet.indexBase = indexBase;
+	meshlet.indexCount = indexCount;
+
+	glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+	for (uint32_t i = indexBase; i < indexBase + indexCount; ++i) {
+		glm::vec3 position = getPosition(mesh, mesh.indexData[i]);
+		boundsMin = glm::min(boundsMin, position);
+		boundsMax = glm::max(boundsMax, position);
+	}
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	float radius = 0.0f;
+	for (uint32_t i = indexBase; i < indexBase + indexCount; ++i)
+		radius = std::max(radius, glm::length(getPosition(mesh, mesh.indexData[i]) - center));
+
+	std::vector<glm::vec3> normals;
+	normals.reserve(indexCount / 3);
+	glm::vec3 axis(0.0f);
+	for (uint32_t i = indexBase; i < indexBase + indexCount; i += 3) {
+		glm::vec3 p0 = getPosition(mesh, mesh.indexData[i]);
+		glm::vec3 p1 = getPosition(mesh, mesh.indexData[i + 1]);
+		glm::vec3 p2 = getPosition(mesh, mesh.indexData[i + 2]);
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0) * orientation;
+		float length = glm::length(normal);
+		if (length == 0.0f)
+			continue;
+		normals.push_back(normal / length);
+		axis += normals.back();
+	}
+
+	// The cone holds every triangle normal; the meshlet is backfacing when the view direction is
+	// within 90 degrees minus the cone angle of its axis, i.e. when its cosine exceeds the cone's sine.
+	float cutoff = MESHLET_CONE_DISABLED;
+	float axisLength = glm::length(axis);
+	if (axisLength > 0.0f) {
+		axis /= axisLength;
+		float minDot = 1.0f;
+		for (auto& normal : normals)
+			minDot = std::min(minDot, glm::dot(normal, axis));
+		if (minDot > 0.0f)
+			cutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+
+	meshlet.sphere[0] = center.x;
+	meshlet.sphere[1] = center.y;
+	meshlet.sphere[2] = center.z;
+	meshlet.sphere[3] = radius;
+	meshlet.cone[0] = axis.x;
+	meshlet.cone[1] = axis.y;
+	meshlet.cone[2] = axis.z;
+	meshlet.cone[3] = cutoff;
+	mesh.meshlets.push_back(meshlet);
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "AssimpModel.h"
+#include "DrawCommands.h"
+
+/** @brief Work done and saved by the culler in the current frame */
+struct MeshletCullStatistics {
+	uint64_t meshletsTested = 0;
+	uint64_t meshletsCulled = 0;
+	uint64_t trianglesTested = 0;
+	uint64_t trianglesCulled = 0;
+};
+
+// Rejects meshlets outside the view frustum or facing away from the camera on the CPU and
+// turns the surviving ones into draws, merging neighbours into one index range.
+// All tests run in model space so the stored bounds are used untransformed.
+class MeshletCuller {
+public:
+	MeshletCuller(AssimpModel* model);
+	void beginFrame(const glm::mat4& viewProjection, glm::vec3 cameraPosition);
+	bool isVisible(int modelIndex, const glm::mat4& modelMatrix);
+	void cull(const DrawItem& item, int modelIndex, uint32_t part, uint32_t lod, const glm::mat4& modelMatrix, std::vector<DrawItem>& drawItems);
+	MeshletCullStatistics getStatistics() { return statistics; }
+
+private:
+	static void extractPlanes(const glm::mat4& clip, glm::vec4 planes[6]);
+	static bool isSimilarity(const glm::mat4& matrix);
+
+	AssimpModel* model;
+	glm::mat4 viewProjection;
+	// World space, normalized
+	glm::vec4 frustumPlanes[6];
+	glm::vec3 cameraPosition;
+	MeshletCullStatistics statistics;
+};
+
+MeshletCuller::MeshletCuller(AssimpModel* inModel) {
+	model = inModel;
+}
+
+void MeshletCuller::beginFrame(const glm::mat4& inViewProjection, glm::vec3 inCameraPosition) {
+	viewProjection = inViewProjection;
+	cameraPosition = inCameraPosition;
+	statistics = MeshletCullStatistics();
+	extractPlanes(viewProjection, frustumPlanes);
+}
+
+void MeshletCuller::extractPlanes(const glm::mat4& clip, glm::vec4 planes[6]) {
+	// Frustum planes of a clip matrix (Gribb and Hartmann), depth range is zero to one.
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i)
+		rows[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[2];
+	planes[5] = rows[3] - rows[2];
+	for (int p = 0; p < 6; ++p)
+		planes[p] /= glm::length(glm::vec3(planes[p]));
+}
+
+bool MeshletCuller::isVisible(int modelIndex, const glm::mat4& modelMatrix) {
+	// Whole-object test for instanced draws, which share their index ranges and so cannot be culled per meshlet.
+	glm::vec4 sphere = model->getBoundingSphere(modelIndex);
+	glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(glm::vec3(sphere), 1.0f));
+	float scale = std::max(glm::length(glm::vec3(modelMatrix[0])), std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+	float radius = sphere.w * scale;
+	for (int p = 0; p < 6; ++p)
+		if (glm::dot(glm::vec3(frustumPlanes[p]), center) + frustumPlanes[p].w < -radius)
+			return false;
+	return true;
+}
+
+bool MeshletCuller::isSimilarity(const glm::mat4& matrix) {
+	// The normal cone is only conservative while the transform keeps angles, i.e. without non-uniform scale or shear.
+	glm::vec3 x(matrix[0]), y(matrix[1]), z(matrix[2]);
+	float lx = glm::length(x), ly = glm::length(y), lz = glm::length(z);
+	const float tolerance = 1e-3f;
+	return std::fabs(lx - ly) <= tolerance * lx && std::fabs(lx - lz) <= tolerance * lx &&
+		std::fabs(glm::dot(x, y)) <= tolerance * lx * ly && std::fabs(glm::dot(x, z)) <= tolerance * lx * lz &&
+		std::fabs(glm::dot(y, z)) <= tolerance * ly * lz;
+}
+
+void MeshletCuller::cull(const DrawItem& item, int modelIndex, uint32_t part, uint32_t lod, const glm::mat4& modelMatrix, std::vector<DrawItem>& drawItems) {
+	glm::vec4 planes[6];
+	extractPlanes(viewProjection * modelMatrix, planes);
+
+	bool coneCulling = isSimilarity(modelMatrix);
+	glm::vec3 eye = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(cameraPosition, 1.0f));
+
+	const Meshlet* meshlets = model->getMeshlets(modelIndex, part, lod);
+	uint32_t meshletCount = model->getMeshletCount(modelIndex, part, lod);
+	if (meshletCount == 0) {
+		drawItems.push_back(item);
+		return;
+	}
+	DrawItem range = item;
+	range.indexCount = 0;
+	for (uint32_t m = 0; m < meshletCount; ++m) {
+		const Meshlet& meshlet = meshlets[m];
+		glm::vec3 center(meshlet.sphere[0], meshlet.sphere[1], meshlet.sphere[2]);
+		float radius = meshlet.sphere[3];
+		statistics.meshletsTested++;
+		statistics.trianglesTested += meshlet.indexCount / 3;
+
+		bool visible = true;
+		for (int p = 0; p < 6 && visible; ++p)
+			visible = glm::dot(glm::vec3(planes[p]), center) + planes[p].w >= -radius;
+
+		if (visible && coneCulling && meshlet.cone[3] < 1.0f) {
+			glm::vec3 axis(meshlet.cone[0], meshlet.cone[1], meshlet.cone[2]);
+			glm::vec3 view = center - eye;
+			visible = glm::dot(view, axis) < meshlet.cone[3] * glm::length(view) + radius;
+		}
+
+		if (!visible) {
+			statistics.meshletsCulled++;
+			statistics.trianglesCulled += meshlet.indexCount / 3;
+			continue;
+		}
+		// Meshlets partition the LOD range in order, so visible neighbours share one draw.
+		uint32_t firstIndex = item.firstIndex + meshlet.indexBase;
+		if (range.indexCount > 0 && range.firstIndex + range.indexCount == firstIndex) {
+			range.indexCount += meshlet.indexCount;
+			continue;
+		}
+		if (range.indexCount > 0)
+			drawItems.push_back(range);
+		range.firstIndex = firstIndex;
+		range.indexCount = meshlet.indexCount;
+	}
+	if (range.indexCount > 0)
+		drawItems.push_back(range);
+}
@@ -0,0 +1,385 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Hash.h"
+#include "ThreadPool.h"
+#include "Vertex.h"
+
+// The file is read in blocks of this size, each parsed by its own job while the next one is read.
+const size_t OBJ_CHUNK_SIZE = 8 << 20;
+
+/** @brief Size and duration of the last load */
+struct ObjLoadStatistics {
+	size_t bytes = 0;
+	size_t vertices = 0;
+	size_t indices = 0;
+	double seconds = 0.0;
+
+	double megabytesPerSecond() { return seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0; }
+	double verticesPerSecond() { return seconds > 0.0 ? vertices / seconds : 0.0; }
+};
+
+// Wavefront OBJ reader for large files. Blocks of whole lines are parsed concurrently into
+// per-block attribute arrays; the blocks are then joined, every face corner is resolved to a
+// packed vertex in parallel, and duplicates are merged through an open-addressing table keyed
+// by a hash of the vertex bytes. Only positions, texture coordinates, normals and faces are read.
+class ObjLoader {
+public:
+	ObjLoader(ThreadPool* threadPool = nullptr);
+	void load(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+	ObjLoadStatistics getStatistics() { return statistics; }
+
+private:
+	// Indices as written in the file after fan triangulation, 0 means the attribute is missing.
+	// Negative indices are relative to the attributes read so far, so the block's counts at the
+	// start of the face are kept with them until the block bases are known.
+	struct Corner {
+		int32_t index[3];
+		uint32_t count[3];
+	};
+
+	static_assert(sizeof(Vertex) == 11 * sizeof(float), "Vertex is hashed and compared as raw bytes");
+
+	struct Chunk {
+		std::vector<char> text;
+		std::vector<float> positions;
+		std::vector<float> texcoords;
+		std::vector<float> normals;
+		std::vector<Corner> corners;
+		size_t base[3] = {};
+		// Resolved vertices and their hashes, one per corner
+		std::vector<Vertex> vertices;
+		std::vector<uint64_t> hashes;
+		bool invalidIndex = false;
+	};
+
+	void run(JobGroup& group, std::function<void()> job);
+	void parseChunk(Chunk& chunk);
+	void resolveChunk(Chunk& chunk);
+	void mergeVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	static const char* skipSpaces(const char* p, const char* end);
+	static const char* parseFloat(const char* p, const char* end, float& value);
+	static const char* parseInt(const char* p, const char* end, int32_t& value);
+
+	ThreadPool* threadPool;
+	std::vector<std::unique_ptr<Chunk>> chunks;
+	std::vector<float> positions;
+	std::vector<float> texcoords;
+	std::vector<float> normals;
+	ObjLoadStatistics statistics;
+};
+
+ObjLoader::ObjLoader(ThreadPool* inThreadPool) {
+	threadPool = inThreadPool;
+}
+
+void ObjLoader::run(JobGroup& group, std::function<void()> job) {
+	if (threadPool)
+		threadPool->enqueue(group, job);
+	else
+		job();
+}
+
+void ObjLoader::load(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	auto start = std::chrono::steady_clock::now();
+	statistics = ObjLoadStatistics();
+	chunks.clear();
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		throw std::runtime_error("Failed to open model file " + path);
+
+	// Blocks end on a line break, the partial line after it is carried into the next block.
+	JobGroup parsing;
+	std::vector<char> carry;
+	while (file) {
+		chunks.push_back(std::unique_ptr<Chunk>(new Chunk()));
+		Chunk* chunk = chunks.back().get();
+		chunk->text.swap(carry);
+		size_t carried = chunk->text.size();
+		chunk->text.resize(carried + OBJ_CHUNK_SIZE);
+		file.read(chunk->text.data() + carried, OBJ_CHUNK_SIZE);
+		size_t read = static_cast<size_t>(file.gcount());
+		chunk->text.resize(carried + read);
+		statistics.bytes += read;
+
+		if (file) {
+			auto lineEnd = std::find(chunk->text.rbegin(), chunk->text.rend(), '\n');
+			if (lineEnd != chunk->text.rend()) {
+				size_t keep = chunk->text.rend() - lineEnd;
+				carry.assign(chunk->text.begin() + keep, chunk->text.end());
+				chunk->text.resize(keep);
+			}
+			else {
+				carry.swap(chunk->text);
+			}
+		}
+		run(parsing, [this, chunk] { parseChunk(*chunk); });
+	}
+	parsing.wait();
+
+	// Attribute indices are global, so each block's arrays start after those of the blocks before it.
+	size_t counts[3] = {};
+	for (auto& chunk : chunks) {
+		chunk->base[0] = counts[0];
+		chunk->base[1] = counts[1];
+		chunk->base[2] = counts[2];
+		counts[0] += chunk->positions.size() / 3;
+		counts[1] += chunk->texcoords.size() / 2;
+		counts[2] += chunk->normals.size() / 3;
+	}
+	positions.clear();
+	texcoords.clear();
+	normals.clear();
+	positions.reserve(counts[0] * 3);
+	texcoords.reserve(counts[1] * 2);
+	normals.reserve(counts[2] * 3);
+	for (auto& chunk : chunks) {
+		positions.insert(positions.end(), chunk->positions.begin(), chunk->positions.end());
+		texcoords.insert(texcoords.end(), chunk->texcoords.begin(), chunk->texcoords.end());
+		normals.insert(normals.end(), chunk->normals.begin(), chunk->normals.end());
+		chunk->positions = std::vector<float>();
+		chunk->texcoords = std::vector<float>();
+		chunk->normals = std::vector<float>();
+	}
+
+	JobGroup resolving;
+	for (auto& chunk : chunks) {
+		Chunk* resolved = chunk.get();
+		run(resolving, [this, resolved] { resolveChunk(*resolved); });
+	}
+	resolving.wait();
+	for (auto& chunk : chunks)
+		if (chunk->invalidIndex)
+			throw std::runtime_error("Failed to load model " + path + ", face index out of range");
+
+	mergeVertices(vertices, indices);
+	chunks.clear();
+	positions = std::vector<float>();
+	texcoords = std::vector<float>();
+	normals = std::vector<float>();
+
+	statistics.vertices = vertices.size();
+	statistics.indices = indices.size();
+	statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+const char* ObjLoader::skipSpaces(const char* p, const char* end) {
+	while (p < end && (*p == ' ' || *p == '\t'))
+		++p;
+	return p;
+}
+
+const char* ObjLoader::parseFloat(const char* p, const char* end, float& value) {
+	// Plain decimal notation with an optional exponent, which is all OBJ exporters write.
+	// Unlike strtof it does not depend on the locale and needs no terminated string.
+	static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+	p = skipSpaces(p, end);
+	double sign = 1.0;
+	if (p < end && (*p == '-' || *p == '+')) {
+		sign = *p == '-' ? -1.0 : 1.0;
+		++p;
+	}
+	uint64_t mantissa = 0;
+	int digits = 0, exponent = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+		if (digits < 18) {
+			mantissa = mantissa * 10 + (*p - '0');
+			digits += mantissa > 0;
+		}
+		else {
+			exponent++;
+		}
+	}
+	if (p < end && *p == '.') {
+		for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+			if (digits < 18) {
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += mantissa > 0;
+				exponent--;
+			}
+		}
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		++p;
+		int exponentSign = 1;
+		if (p < end && (*p == '-' || *p == '+')) {
+			exponentSign = *p == '-' ? -1 : 1;
+			++p;
+		}
+		int written = 0;
+		for (; p < end && *p >= '0' && *p <= '9'; ++p)
+			written = std::min(written * 10 + (*p - '0'), 1000);
+		exponent += exponentSign * written;
+	}
+	double result = static_cast<double>(mantissa);
+	if (exponent < 0)
+		result = -exponent <= 18 ? result / powers[-exponent] : result * std::pow(10.0, exponent);
+	else if (exponent > 0)
+		result = exponent <= 18 ? result * powers[exponent] : result * std::pow(10.0, exponent);
+	value = static_cast<float>(sign * result);
+	return p;
+}
+
+const char* ObjLoader::parseInt(const char* p, const char* end, int32_t& value) {
+	int32_t sign = 1;
+	if (p < end && *p == '-') {
+		sign = -1;
+		++p;
+	}
+	int32_t result = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; ++p)
+		result = result * 10 + (*p - '0');
+	value = sign * result;
+	return p;
+}
+
+void ObjLoader::parseChunk(Chunk& chunk) {
+	const char* p = chunk.text.data();
+	const char* end = p + chunk.text.size();
+	std::vector<Corner> polygon;
+
+	while (p < end) {
+		p = skipSpaces(p, end);
+		const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+		if (!lineEnd)
+			lineEnd = end;
+
+		if (lineEnd - p >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+			float value;
+			const char* q = p + 1;
+			for (int i = 0; i < 3; ++i) {
+				q = parseFloat(q, lineEnd, value);
+				chunk.positions.push_back(value);
+			}
+		}
+		else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t')) {
+			float value;
+			const char* q = p + 2;
+			for (int i = 0; i < 2; ++i) {
+				q = parseFloat(q, lineEnd, value);
+				chunk.texcoords.push_back(value);
+			}
+		}
+		else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+			float value;
+			const char* q = p + 2;
+			for (int i = 0; i < 3; ++i) {
+				q = parseFloat(q, lineEnd, value);
+				chunk.normals.push_back(value);
+			}
+		}
+		else if (lineEnd - p >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+			polygon.clear();
+			const char* q = skipSpaces(p + 1, lineEnd);
+			while (q < lineEnd && *q != '\r' && *q != '#') {
+				// v, v/vt, v//vn or v/vt/vn
+				Corner corner{};
+				corner.count[0] = static_cast<uint32_t>(chunk.positions.size() / 3);
+				corner.count[1] = static_cast<uint32_t>(chunk.texcoords.size() / 2);
+				corner.count[2] = static_cast<uint32_t>(chunk.normals.size() / 3);
+				for (int attribute = 0; attribute < 3; ++attribute) {
+					q = parseInt(q, lineEnd, corner.index[attribute]);
+					if (q >= lineEnd || *q != '/')
+						break;
+					++q;
+				}
+				polygon.push_back(corner);
+				while (q < lineEnd && *q != ' ' && *q != '\t')
+					++q;
+				q = skipSpaces(q, lineEnd);
+			}
+			for (size_t i = 2; i < polygon.size(); ++i) {
+				chunk.corners.push_back(polygon[0]);
+				chunk.corners.push_back(polygon[i - 1]);
+				chunk.corners.push_back(polygon[i]);
+			}
+		}
+		p = lineEnd + 1;
+	}
+	chunk.text = std::vector<char>();
+}
+
+void ObjLoader::resolveChunk(Chunk& chunk) {
+	const float* attributes[3] = { positions.data(), texcoords.data(), normals.data() };
+	const size_t sizes[3] = { positions.size() / 3, texcoords.size() / 2, normals.size() / 3 };
+
+	chunk.vertices.resize(chunk.corners.size());
+	chunk.hashes.resize(chunk.corners.size());
+	for (size_t c = 0; c < chunk.corners.size(); ++c) {
+		const Corner& corner = chunk.corners[c];
+		int64_t resolved[3];
+		for (int attribute = 0; attribute < 3; ++attribute) {
+			int64_t index = corner.index[attribute];
+			if (index > 0)
+				resolved[attribute] = index - 1;
+			else if (index < 0)
+				resolved[attribute] = static_cast<int64_t>(chunk.base[attribute] + corner.count[attribute]) + index;
+			else
+				resolved[attribute] = -1;
+			if (resolved[attribute] >= static_cast<int64_t>(sizes[attribute]) || (attribute == 0 && resolved[attribute] < 0)) {
+				chunk.invalidIndex = true;
+				return;
+			}
+		}
+
+		// Vertex is all floats without padding, so its bytes are a complete key.
+		Vertex& vertex = chunk.vertices[c];
+		const float* position = attributes[0] + resolved[0] * 3;
+		vertex.pos = glm::vec3(position[0], position[1], position[2]);
+		vertex.color = glm::vec3(1.0f);
+		vertex.texCoord = glm::vec2(0.0f);
+		vertex.normal = glm::vec3(0.0f);
+		if (resolved[1] >= 0) {
+			const float* texcoord = attributes[1] + resolved[1] * 2;
+			vertex.texCoord = glm::vec2(texcoord[0], 1.0f - texcoord[1]);
+		}
+		if (resolved[2] >= 0) {
+			const float* normal = attributes[2] + resolved[2] * 3;
+			vertex.normal = glm::vec3(normal[0], normal[1], normal[2]);
+		}
+		chunk.hashes[c] = hashBytes(&vertex, sizeof(Vertex));
+	}
+	chunk.corners = std::vector<Corner>();
+}
+
+void ObjLoader::mergeVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	size_t cornerCount = 0;
+	for (auto& chunk : chunks)
+		cornerCount += chunk->vertices.size();
+
+	// Linear probing at a load factor of at most one half; slots hold vertex indices.
+	size_t capacity = 1;
+	while (capacity < cornerCount * 2)
+		capacity <<= 1;
+	std::vector<uint32_t> table(capacity, UINT32_MAX);
+	size_t mask = capacity - 1;
+
+	vertices.clear();
+	indices.clear();
+	indices.reserve(cornerCount);
+	for (auto& chunk : chunks) {
+		for (size_t c = 0; c < chunk->vertices.size(); ++c) {
+			const Vertex& vertex = chunk->vertices[c];
+			size_t slot = static_cast<size_t>(chunk->hashes[c]) & mask;
+			while (table[slot] != UINT32_MAX && memcmp(&vertices[table[slot]], &vertex, sizeof(Vertex)) != 0)
+				slot = (slot + 1) & mask;
+			if (table[slot] == UINT32_MAX) {
+				table[slot] = static_cast<uint32_t>(vertices.size());
+				vertices.push_back(vertex);
+			}
+			indices.push_back(table[slot]);
+		}
+		chunk->vertices = std::vector<Vertex>();
+		chunk->hashes = std::vector<uint64_t>();
+	}
+}
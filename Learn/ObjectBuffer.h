@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "LogicalDevice.h"
+#include "Buffer.h"
+#include "DeletionQueue.h"
+
+// Laid out like ObjectData in the vertex shaders (std430), where the columns of the mat3 are padded to vec4.
+struct ObjectData {
+	alignas(16) glm::mat4 model;
+	alignas(16) glm::vec4 normalMatrix[3];
+	uint32_t material;
+	uint32_t padding[3];
+};
+static_assert(sizeof(ObjectData) == 128, "ObjectData must match the shader layout");
+
+const uint32_t DEFAULT_OBJECT_CAPACITY = 1024;
+
+// Per-object data of the whole scene in one device-local storage buffer, indexed by object ID in the shaders.
+// A CPU copy of every object is kept and only objects written since the last frame are uploaded: each frame
+// slot stages them in its own host-visible buffer, and its command buffer copies them before the render pass.
+// The buffer at least doubles when objects are added past its capacity; the old one is retired through the
+// deletion queue and every object is uploaded into the new one.
+class ObjectBuffer {
+public:
+	~ObjectBuffer();
+	ObjectBuffer(LogicalDevice* device, uint32_t frameCount, uint32_t capacity = DEFAULT_OBJECT_CAPACITY);
+	Buffer* getBufferRef() { return buffer; }
+	uint32_t getObjectCount() { return static_cast<uint32_t>(objects.size()); }
+
+	void resize(uint32_t objectCount);
+	void setObject(uint32_t object, const glm::mat4& model, uint32_t material);
+	void prepareFrame(uint32_t frameIndex, DeletionQueue* deletionQueue);
+	void recordUpload(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+private:
+	struct FrameStaging {
+		Buffer* buffer = nullptr;
+		uint32_t capacity = 0;
+		std::vector<VkBufferCopy> regions;
+	};
+
+	void createBuffer(uint32_t capacity);
+	void stageDirtyObjects(FrameStaging& frame);
+
+	LogicalDevice* device;
+	Buffer* buffer = nullptr;
+	uint32_t capacity = 0;
+
+	std::vector<ObjectData> objects;
+	std::vector<bool> dirty;
+	std::vector<uint32_t> dirtyObjects;
+	std::vector<FrameStaging> frames;
+};
+
+ObjectBuffer::~ObjectBuffer() {
+	for (auto& frame : frames)
+		delete frame.buffer;
+	delete buffer;
+}
+
+ObjectBuffer::ObjectBuffer(LogicalDevice* inDevice, uint32_t frameCount, uint32_t inCapacity) {
+	device = inDevice;
+	frames.resize(frameCount);
+	createBuffer(std::max(inCapacity, 1u));
+}
+
+void ObjectBuffer::createBuffer(uint32_t inCapacity) {
+	capacity = inCapacity;
+	buffer = new Buffer(device, capacity * sizeof(ObjectData),
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+void ObjectBuffer::resize(uint32_t objectCount) {
+	if (objectCount <= objects.size()) {
+		objects.resize(objectCount);
+		dirty.resize(objectCount);
+		dirtyObjects.erase(std::remove_if(dirtyObjects.begin(), dirtyObjects.end(),
+			[objectCount](uint32_t object) { return object >= objectCount; }), dirtyObjects.end());
+		return;
+	}
+	// New objects are identity transforms until they are set.
+	ObjectData identity{};
+	identity.model = glm::mat4(1.0f);
+	for (int column = 0; column < 3; ++column)
+		identity.normalMatrix[column][column] = 1.0f;
+	for (uint32_t object = static_cast<uint32_t>(objects.size()); object < objectCount; ++object) {
+		objects.push_back(identity);
+		dirty.push_back(true);
+		dirtyObjects.push_back(object);
+	}
+}
+
+void ObjectBuffer::setObject(uint32_t object, const glm::mat4& model, uint32_t material) {
+	ObjectData& data = objects[object];
+	data.model = model;
+	// Inverse transpose, so normals stay perpendicular under shear and non-uniform scale.
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+	for (int column = 0; column < 3; ++column)
+		data.normalMatrix[column] = glm::vec4(normalMatrix[column], 0.0f);
+	data.material = material;
+	if (!dirty[object]) {
+		dirty[object] = true;
+		dirtyObjects.push_back(object);
+	}
+}
+
+void ObjectBuffer::prepareFrame(uint32_t frameIndex, DeletionQueue* deletionQueue) {
+	// Frames in flight still read the old buffer, so it is only destroyed after them.
+	if (objects.size() > capacity) {
+		Buffer* oldBuffer = buffer;
+		deletionQueue->push([oldBuffer] { delete oldBuffer; });
+		createBuffer(std::max(static_cast<uint32_t>(objects.size()), 2 * capacity));
+		dirtyObjects.clear();
+		for (uint32_t object = 0; object < objects.size(); ++object) {
+			dirty[object] = true;
+			dirtyObjects.push_back(object);
+		}
+	}
+	FrameStaging& frame = frames[frameIndex];
+	frame.regions.clear();
+	if (!dirtyObjects.empty())
+		stageDirtyObjects(frame);
+}
+
+void ObjectBuffer::stageDirtyObjects(FrameStaging& frame) {
+	// The slot's fence has signaled, so its staging buffer is free to be rewritten or replaced.
+	uint32_t dirtyCount = static_cast<uint32_t>(dirtyObjects.size());
+	if (dirtyCount > frame.capacity) {
+		delete frame.buffer;
+		frame.capacity = std::max(dirtyCount, 2 * frame.capacity);
+		frame.buffer = new Buffer(device, frame.capacity * sizeof(ObjectData),
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		if (frame.buffer->getMappedData() == nullptr)
+			throw std::runtime_error("Failed to map object staging buffer.");
+	}
+
+	// Sorted, so runs of neighbouring objects become a single copy region.
+	std::sort(dirtyObjects.begin(), dirtyObjects.end());
+	ObjectData* staged = static_cast<ObjectData*>(frame.buffer->getMappedData());
+	for (uint32_t i = 0; i < dirtyCount; ++i) {
+		uint32_t object = dirtyObjects[i];
+		staged[i] = objects[object];
+		dirty[object] = false;
+		VkDeviceSize srcOffset = i * sizeof(ObjectData);
+		VkDeviceSize dstOffset = object * sizeof(ObjectData);
+		if (!frame.regions.empty() && frame.regions.back().dstOffset + frame.regions.back().size == dstOffset)
+			frame.regions.back().size += sizeof(ObjectData);
+		else
+			frame.regions.push_back({ srcOffset, dstOffset, sizeof(ObjectData) });
+	}
+	device->getAllocator()->flush(frame.buffer->getAllocation(), 0, dirtyCount * sizeof(ObjectData));
+	dirtyObjects.clear();
+}
+
+void ObjectBuffer::recordUpload(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+	FrameStaging& frame = frames[frameIndex];
+	if (frame.regions.empty())
+		return;
+
+	// Earlier frames may still read the objects being overwritten.
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, nullptr, 0, nullptr, 0, nullptr);
+	vkCmdCopyBuffer(commandBuffer, frame.buffer->getBuffer(), buffer->getBuffer(), static_cast<uint32_t>(frame.regions.size()), frame.regions.data());
+
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer->getBuffer();
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+		0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
@@ -10,6 +10,8 @@
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphic;
 	std::optional<uint32_t> present;
+	std::optional<uint32_t> transfer;
+	std::optional<uint32_t> compute;
 	bool isCompleted() { return graphic.has_value() && present.has_value();	}
 };
 
@@ -27,8 +29,13 @@ public:
 	VkPhysicalDevice& getDevice() { return device; }
 	QueueFamilyIndices& getQueueFamilyIndices() { return queueFamilyIndices; }
 	VkPhysicalDeviceProperties& getProperties() { return properties; }
+	VkPhysicalDeviceMemoryProperties& getMemoryProperties() { return memProperties; }
+	std::vector<const char*>& getExtensions() { return extensions; }
+	bool isHeadless() { return window == nullptr; }
 	uint32_t getGraphicQueueIndex() { return queueFamilyIndices.graphic.value(); }
 	uint32_t getPresentQueueIndex() { return queueFamilyIndices.present.value(); }
+	uint32_t getTransferQueueIndex() { return queueFamilyIndices.transfer.value(); }
+	uint32_t getComputeQueueIndex() { return queueFamilyIndices.compute.value(); }
 	SwapChainSupportDetails retrieveSwapChainSupportDetails(VkPhysicalDevice candidate, Window* win);
 	VkPhysicalDeviceFeatures& getFeatures() { return features; }
 	VkSampleCountFlagBits getMsaaSamples() { return msaaSamples; }
@@ -62,6 +69,8 @@ private:
 PhysicalDevice::PhysicalDevice(Instance* instance, Window* win) {
 	vkInstance = instance;
 	window = win;
+	if (isHeadless())
+		extensions.clear();
 	selectPhysicalDevice();
 	vkGetPhysicalDeviceMemoryProperties(device, &memProperties);
 	
@@ -96,7 +105,7 @@ bool PhysicalDevice::isDeviceSuitable(VkPhysicalDevice candidate) {
 
 	bool queueFamilySupported = isQueueFamilySupported(candidate);
 	bool extensionsSupported = isExtensionSupported(candidate);
-	bool swapChainSupported = isSwapChainSupported(candidate);
+	bool swapChainSupported = isHeadless() || isSwapChainSupported(candidate);
 	bool featureSupported = isPhysicalDeviceFeatureSupported(candidate);
 	
 	return queueFamilySupported && extensionsSupported && swapChainSupported && featureSupported;
@@ -113,21 +122,43 @@ void PhysicalDevice::retrieveQueueFamiliesIndices(VkPhysicalDevice candidate) {
 	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
 	vkGetPhysicalDeviceQueueFamilyProperties(candidate, &queueFamilyCount, queueFamilies.data());
 
-	uint32_t index = 0;
-	for (const auto& queueFamily : queueFamilies) {
-		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+	queueFamilyIndices = QueueFamilyIndices();
+	bool transferIsCopyOnly = false;
+	for (uint32_t index = 0; index < queueFamilyCount; ++index) {
+		VkQueueFlags flags = queueFamilies[index].queueFlags;
+		if ((flags & VK_QUEUE_GRAPHICS_BIT) && !queueFamilyIndices.graphic.has_value())
 			queueFamilyIndices.graphic = index;
 
+		// Offscreen rendering never presents, so the graphics queue stands in for the present queue.
 		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(candidate, index, window->surface, &presentSupport);
+		if (isHeadless())
+			presentSupport = index == queueFamilyIndices.graphic;
+		else
+			vkGetPhysicalDeviceSurfaceSupportKHR(candidate, index, window->surface, &presentSupport);
 
-		if (presentSupport) 
+		// Presenting from the graphics family avoids an ownership transfer of every swap chain image.
+		if (presentSupport && (!queueFamilyIndices.present.has_value() || index == queueFamilyIndices.graphic))
 			queueFamilyIndices.present = index;
 
-		if (queueFamilyIndices.isCompleted())
-			break;
-		else
-			index++;
+		// A family without graphics or compute is usually backed by the copy engines, so prefer it for streaming.
+		if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+			bool copyOnly = !(flags & VK_QUEUE_COMPUTE_BIT);
+			if (!queueFamilyIndices.transfer.has_value() || (copyOnly && !transferIsCopyOnly)) {
+				queueFamilyIndices.transfer = index;
+				transferIsCopyOnly = copyOnly;
+			}
+		}
+
+		if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && !queueFamilyIndices.compute.has_value())
+			queueFamilyIndices.compute = index;
+	}
+
+	// Devices with a single family, software rasterizers included, run everything on the graphics queue.
+	if (queueFamilyIndices.graphic.has_value()) {
+		if (!queueFamilyIndices.transfer.has_value())
+			queueFamilyIndices.transfer = queueFamilyIndices.graphic;
+		if (!queueFamilyIndices.compute.has_value())
+			queueFamilyIndices.compute = queueFamilyIndices.graphic;
 	}
 }
 
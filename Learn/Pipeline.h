@@ -1,95 +1,211 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
 #include "LogicalDevice.h"
+#include "PipelineCache.h"
 #include "ShaderModule.h"
-#include "SwapChain.h"
 #include "DescriptorSetLayout.h"
 #include "RenderPass.h"
-#include "AssimpModel.h"
+#include "VertexLayout.h"
+#include "ThreadPool.h"
+
+// Where compiled shaders are loaded from; the CMake build points this at its own output.
+#ifndef SHADER_DIR
+#define SHADER_DIR "shaders/"
+#endif
+
+enum PipelineShading {
+	PIPELINE_SHADING_PHONG,
+	PIPELINE_SHADING_GOURAUD,
+	PIPELINE_SHADING_FLAT,
+	PIPELINE_SHADING_COUNT
+};
+
+// Index of the depth prepass pipeline, which follows the shading pipelines when it is enabled.
+const uint32_t PIPELINE_DEPTH_PREPASS = PIPELINE_SHADING_COUNT;
+
+// Written as objectIndex by draws whose objects come from the instance list.
+const uint32_t DRAW_OBJECT_FROM_INSTANCE = UINT32_MAX;
+
+// Per-draw data in the push constant range of every pipeline, matching DrawConstants in the vertex shaders.
+struct DrawConstants {
+	uint32_t objectIndex;
+	uint32_t lod;
+	uint32_t material;
+};
+
+struct PipelineDescription {
+	std::string name;
+	std::string vertexShader;
+	// Empty for depth-only pipelines, which write no colour
+	std::string fragmentShader;
+	VertexInputUsage vertexInput = VERTEX_INPUT_ALL;
+};
 
+// Graphics pipelines sharing one layout, compiled concurrently on a thread pool into the shared cache.
+// Every pipeline is published through a future, so frames can start drawing the objects whose
+// pipelines are ready while the rest are still compiling. A pipeline that failed to compile never
+// becomes ready; its error is reported once and hasFailed() lets the caller fall back.
 class Pipeline {
 public:
 	~Pipeline();
-	Pipeline(LogicalDevice* device, SwapChain* swapChain, DescriptorSetLayout* descriptorSetLayout, RenderPass* renderPass, VertexLayout* vertexLayout);
+	Pipeline(LogicalDevice* device, DescriptorSetLayout* descriptorSetLayout, RenderPass* renderPass, VertexLayout* vertexLayout,
+		PipelineCache* pipelineCache, ThreadPool* threadPool, bool depthPrepass = false);
 	VkPipelineLayout& getPipelineLayout() { return layout; }
-	VkPipeline& getPhongPipeline() { return phong; }
-	VkPipeline& getGouraudPipeline() { return gouraud; }
-	VkPipeline& getFlatPipeline() { return flat; }
+	bool hasDepthPrepass() { return depthPrepass; }
+	/** @brief Shading pipelines plus the depth prepass if there is one */
+	uint32_t getPipelineCount() { return static_cast<uint32_t>(pipelines.size()); }
+	std::shared_future<VkPipeline> getPipelineFuture(uint32_t index) { return pipelines[index]; }
+	bool isReady(uint32_t index) { return getState(index) == PIPELINE_STATE_READY; }
+	bool hasFailed(uint32_t index) { return getState(index) == PIPELINE_STATE_FAILED; }
+	/** @brief Only valid once isReady() returned true */
+	VkPipeline getPipeline(uint32_t index) { return pipelines[index].get(); }
+	VkPipeline getPhongPipeline() { return getPipeline(PIPELINE_SHADING_PHONG); }
+	VkPipeline getGouraudPipeline() { return getPipeline(PIPELINE_SHADING_GOURAUD); }
+	VkPipeline getFlatPipeline() { return getPipeline(PIPELINE_SHADING_FLAT); }
+	VkPipeline getDepthPrepassPipeline() { return getPipeline(PIPELINE_DEPTH_PREPASS); }
 
 private:
-	void createPipelineCache();
-	void createGraphicsPipeline();
+	enum PipelineState {
+		PIPELINE_STATE_COMPILING,
+		PIPELINE_STATE_READY,
+		PIPELINE_STATE_FAILED
+	};
+
+	PipelineState getState(uint32_t index);
+	void checkShaderInterface(ShaderModule& shader, const std::string& filename);
+	void createGraphicsPipelines(const std::vector<PipelineDescription>& descriptions);
+	VkPipeline createGraphicsPipeline(const PipelineDescription& description);
 	void setupShaderStageCreateInfo(VkPipelineShaderStageCreateInfo& createInfo, VkShaderStageFlagBits stage, ShaderModule& module);
 	void setupVertexInputStateCreateInfo(VkPipelineVertexInputStateCreateInfo& createInfo,
-		VkVertexInputBindingDescription& binding,
+		std::vector<VkVertexInputBindingDescription>& bindings,
 		std::vector<VkVertexInputAttributeDescription>& attributes);
 	void setupInputAssemblyStateCreateInfo(VkPipelineInputAssemblyStateCreateInfo& createInfo);
-	void setupViewport(VkViewport& viewport);
-	void setupViewportStateCreateInfo(VkPipelineViewportStateCreateInfo& createInfo, VkViewport& viewport, VkRect2D& scissor);
+	void setupViewportStateCreateInfo(VkPipelineViewportStateCreateInfo& createInfo);
 	void setupRasterizationStateCreateInfo(VkPipelineRasterizationStateCreateInfo& createInfo);
-	void setupDepthStencilStateCreateInfo(VkPipelineDepthStencilStateCreateInfo& createInfo);
+	void setupDepthStencilStateCreateInfo(VkPipelineDepthStencilStateCreateInfo& createInfo, bool depthOnly);
 	void setupMultisampleStateCreateInfo(VkPipelineMultisampleStateCreateInfo& createInfo);
-	void setupColorBlendStateCreateInfo(VkPipelineColorBlendStateCreateInfo& createInfo, VkPipelineColorBlendAttachmentState& attachment);
-	void setupColorBlendAttachmentState(VkPipelineColorBlendAttachmentState& attachment);
+	void setupColorBlendStateCreateInfo(VkPipelineColorBlendStateCreateInfo& createInfo, VkPipelineColorBlendAttachmentState& attachment, bool depthOnly);
+	void setupColorBlendAttachmentState(VkPipelineColorBlendAttachmentState& attachment, bool depthOnly);
 
 	void createPipelineLayout();
 	void setupLayoutCreateInfo(VkPipelineLayoutCreateInfo& createInfo);
 
 	LogicalDevice* device;
-	SwapChain* swapChain;
 	DescriptorSetLayout* descriptorSetLayout;
 	RenderPass* renderPass;
 	VertexLayout* vertexLayout;
 	VkPipelineLayout layout;
-	VkPipelineCache pipelineCache;
-
-	VkPipeline phong;
-	VkPipeline gouraud;
-	VkPipeline flat;
+	PipelineCache* pipelineCache;
+	ThreadPool* threadPool;
+	bool depthPrepass;
+
+	JobGroup compiling;
+	std::atomic<uint32_t> remaining;
+	std::chrono::time_point<std::chrono::steady_clock> compileStart;
+	std::vector<std::shared_future<VkPipeline>> pipelines;
+	// Only read and written by the render thread
+	std::vector<PipelineState> states;
 };
 
 Pipeline::~Pipeline() {
-	vkDestroyPipeline(device->getDevice(), phong, nullptr);
-	vkDestroyPipeline(device->getDevice(), gouraud, nullptr);
-	vkDestroyPipeline(device->getDevice(), flat, nullptr);
+	compiling.wait();
+	for (auto& pipeline : pipelines) {
+		// Pipelines that failed to compile hold an exception instead of a handle.
+		try {
+			vkDestroyPipeline(device->getDevice(), pipeline.get(), nullptr);
+		}
+		catch (...) {
+		}
+	}
 	vkDestroyPipelineLayout(device->getDevice(), layout, nullptr);
-	vkDestroyPipelineCache(device->getDevice(), pipelineCache, nullptr);
 }
 
-Pipeline::Pipeline(LogicalDevice* inDevice, SwapChain* inSwapChain, DescriptorSetLayout* inDescriptorSetLayout, 
-	RenderPass* inRenderPass, VertexLayout* inVertexLayout) {
+Pipeline::Pipeline(LogicalDevice* inDevice, DescriptorSetLayout* inDescriptorSetLayout, 
+	RenderPass* inRenderPass, VertexLayout* inVertexLayout, PipelineCache* inPipelineCache, ThreadPool* inThreadPool, bool inDepthPrepass) {
 	device = inDevice;
-	swapChain = inSwapChain;
 	descriptorSetLayout = inDescriptorSetLayout;
 	renderPass = inRenderPass;
 	vertexLayout = inVertexLayout;
+	pipelineCache = inPipelineCache;
+	threadPool = inThreadPool;
+	depthPrepass = inDepthPrepass;
+
+	std::vector<PipelineDescription> descriptions = {
+		{ "phong", SHADER_DIR "phong.vert.spv", SHADER_DIR "phong.frag.spv" },
+		{ "gouraud", SHADER_DIR "gouraud.vert.spv", SHADER_DIR "gouraud.frag.spv" },
+		{ "flat", SHADER_DIR "flat.vert.spv", SHADER_DIR "flat.frag.spv" },
+	};
+	// The prepass only fetches the position stream and has no fragment stage.
+	if (depthPrepass)
+		descriptions.push_back({ "depth prepass", SHADER_DIR "depth.vert.spv", "", VERTEX_INPUT_POSITION_ONLY });
 
-	createPipelineCache();
-	createGraphicsPipeline();
+	createPipelineLayout();
+	createGraphicsPipelines(descriptions);
+}
+
+Pipeline::PipelineState Pipeline::getState(uint32_t index) {
+	if (states[index] != PIPELINE_STATE_COMPILING || pipelines[index].wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return states[index];
+	// A failed compilation holds its exception, which is reported here once instead of rethrown every frame.
+	try {
+		pipelines[index].get();
+		states[index] = PIPELINE_STATE_READY;
+	}
+	catch (const std::exception& error) {
+		std::cerr << error.what() << "\n";
+		states[index] = PIPELINE_STATE_FAILED;
+	}
+	return states[index];
 }
 
-void Pipeline::createPipelineCache() {
-	VkPipelineCacheCreateInfo createInfo{};
-	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-	vkCreatePipelineCache(device->getDevice(), &createInfo, nullptr, &pipelineCache);
+void Pipeline::createGraphicsPipelines(const std::vector<PipelineDescription>& descriptions) {
+	compileStart = std::chrono::steady_clock::now();
+	remaining = static_cast<uint32_t>(descriptions.size());
+	pipelines.resize(descriptions.size());
+	states.resize(descriptions.size(), PIPELINE_STATE_COMPILING);
+
+	for (size_t i = 0; i < descriptions.size(); ++i) {
+		auto promise = std::make_shared<std::promise<VkPipeline>>();
+		pipelines[i] = promise->get_future().share();
+
+		threadPool->enqueue(compiling, [this, promise, description = descriptions[i]] {
+			try {
+				promise->set_value(createGraphicsPipeline(description));
+			}
+			catch (...) {
+				promise->set_exception(std::current_exception());
+			}
+
+			if (--remaining == 0) {
+				auto end = std::chrono::steady_clock::now();
+				std::cout << "Created graphics pipelines in " << std::chrono::duration<double, std::milli>(end - compileStart).count()
+					<< " ms (" << (pipelineCache->isWarm() ? "warm" : "cold") << " pipeline cache).\n";
+			}
+		});
+	}
 }
 
-void Pipeline::createGraphicsPipeline() {
-	ShaderModule gouraudVertShader(device, "shaders/gouraud.vert.spv");
-	ShaderModule gouraudFragShader(device, "shaders/gouraud.frag.spv");
-	ShaderModule phongVertShader(device, "shaders/phong.vert.spv");
-	ShaderModule phongFragShader(device, "shaders/phong.frag.spv");
-	ShaderModule flatVertShader(device, "shaders/flat.vert.spv");
-	ShaderModule flatFragShader(device, "shaders/flat.frag.spv");
+VkPipeline Pipeline::createGraphicsPipeline(const PipelineDescription& description) {
+	// Runs on a worker thread: all create infos are local, the cache is internally synchronized.
+	bool depthOnly = description.fragmentShader.empty();
+	ShaderModule vertShader(device, description.vertexShader);
+	checkShaderInterface(vertShader, description.vertexShader);
+	std::unique_ptr<ShaderModule> fragShader;
+	if (!depthOnly)
+		fragShader.reset(new ShaderModule(device, description.fragmentShader));
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
 	setupInputAssemblyStateCreateInfo(inputAssembly);
 
 	VkPipelineViewportStateCreateInfo viewportState{};
-	VkViewport viewport{};
-	VkRect2D scissor{};
-	setupViewportStateCreateInfo(viewportState, viewport, scissor);
-	
+	setupViewportStateCreateInfo(viewportState);
+
+	// Viewport and scissor are set by every command buffer, so pipelines do not depend on the swap chain extent.
 	std::vector<VkDynamicState> dynamicStateEnables;
 	dynamicStateEnables.push_back(VK_DYNAMIC_STATE_VIEWPORT);
 	dynamicStateEnables.push_back(VK_DYNAMIC_STATE_SCISSOR);
@@ -105,23 +221,27 @@ void Pipeline::createGraphicsPipeline() {
 	setupMultisampleStateCreateInfo(multisample);
 
 	VkPipelineDepthStencilStateCreateInfo depthStencil{};
-	setupDepthStencilStateCreateInfo(depthStencil);
-
+	setupDepthStencilStateCreateInfo(depthStencil, depthOnly);
 
 	VkPipelineColorBlendStateCreateInfo colorBlend{};
 	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-	setupColorBlendStateCreateInfo(colorBlend, colorBlendAttachment);
-
-	createPipelineLayout();
+	setupColorBlendStateCreateInfo(colorBlend, colorBlendAttachment, depthOnly);
 
 	VkPipelineVertexInputStateCreateInfo vertexInput{};
-	auto bindingDescription = vertexLayout->getBindingDescription();
-	auto attributeDescriptions = vertexLayout->getVertexInputAttributeDescriptions();
-	setupVertexInputStateCreateInfo(vertexInput, bindingDescription, attributeDescriptions);
+	auto bindingDescriptions = vertexLayout->getBindingDescriptions(description.vertexInput);
+	auto attributeDescriptions = vertexLayout->getVertexInputAttributeDescriptions(description.vertexInput);
+	setupVertexInputStateCreateInfo(vertexInput, bindingDescriptions, attributeDescriptions);
 
+	VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+	setupShaderStageCreateInfo(shaderStages[0], VK_SHADER_STAGE_VERTEX_BIT, vertShader);
+	if (!depthOnly)
+		setupShaderStageCreateInfo(shaderStages[1], VK_SHADER_STAGE_FRAGMENT_BIT, *fragShader);
+
+	// No derivatives: a derivative has to wait for its base, which would serialize the builds again.
 	VkGraphicsPipelineCreateInfo pipelineInfo{};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;
+	pipelineInfo.stageCount = depthOnly ? 1 : 2;
+	pipelineInfo.pStages = shaderStages;
 	pipelineInfo.pVertexInputState = &vertexInput;
 	pipelineInfo.pInputAssemblyState = &inputAssembly;
 	pipelineInfo.pViewportState = &viewportState;
@@ -134,31 +254,12 @@ void Pipeline::createGraphicsPipeline() {
 	pipelineInfo.renderPass = renderPass->getRenderPass();
 	pipelineInfo.subpass = 0;
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-	pipelineInfo.flags = VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
-
-	VkPipelineShaderStageCreateInfo shaderStages[2] = {};
-	pipelineInfo.pStages = shaderStages;
-
-	setupShaderStageCreateInfo(shaderStages[0], VK_SHADER_STAGE_VERTEX_BIT, phongVertShader);
-	setupShaderStageCreateInfo(shaderStages[1], VK_SHADER_STAGE_FRAGMENT_BIT, phongFragShader);
-
-	if (vkCreateGraphicsPipelines(device->getDevice(), pipelineCache, 1, &pipelineInfo, nullptr, &phong) != VK_SUCCESS)
-		throw std::runtime_error("Failed to create phong graphic pipeline");
-
-	pipelineInfo.basePipelineHandle = phong;
-	pipelineInfo.flags = VK_PIPELINE_CREATE_DERIVATIVE_BIT;
 	pipelineInfo.basePipelineIndex = -1;
 
-	setupShaderStageCreateInfo(shaderStages[0], VK_SHADER_STAGE_VERTEX_BIT, gouraudVertShader);
-	setupShaderStageCreateInfo(shaderStages[1], VK_SHADER_STAGE_FRAGMENT_BIT, gouraudFragShader);
-	if (vkCreateGraphicsPipelines(device->getDevice(), pipelineCache, 1, &pipelineInfo, nullptr, &gouraud) != VK_SUCCESS)
-		throw std::runtime_error("Failed to create gouraud graphic pipeline");
-
-	setupShaderStageCreateInfo(shaderStages[0], VK_SHADER_STAGE_VERTEX_BIT, flatVertShader);
-	setupShaderStageCreateInfo(shaderStages[1], VK_SHADER_STAGE_FRAGMENT_BIT, flatFragShader);
-	if (vkCreateGraphicsPipelines(device->getDevice(), pipelineCache, 1, &pipelineInfo, nullptr, &flat) != VK_SUCCESS)
-		throw std::runtime_error("Failed to create flat graphic pipeline");
-
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(device->getDevice(), pipelineCache->getPipelineCache(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create " + description.name + " graphic pipeline");
+	return pipeline;
 }
 
 void Pipeline::setupShaderStageCreateInfo(VkPipelineShaderStageCreateInfo& createInfo, VkShaderStageFlagBits stage, ShaderModule& module) {
@@ -169,11 +270,11 @@ void Pipeline::setupShaderStageCreateInfo(VkPipelineShaderStageCreateInfo& creat
 }
 
 void Pipeline::setupVertexInputStateCreateInfo(VkPipelineVertexInputStateCreateInfo& createInfo,
-	VkVertexInputBindingDescription& binding,
+	std::vector<VkVertexInputBindingDescription>& bindings,
 	std::vector<VkVertexInputAttributeDescription>& attributes) {
 	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	createInfo.vertexBindingDescriptionCount = 1;
-	createInfo.pVertexBindingDescriptions = &binding;
+	createInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
+	createInfo.pVertexBindingDescriptions = bindings.data();
 	createInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
 	createInfo.pVertexAttributeDescriptions = attributes.data();
 }
@@ -184,25 +285,13 @@ void Pipeline::setupInputAssemblyStateCreateInfo(VkPipelineInputAssemblyStateCre
 	createInfo.primitiveRestartEnable = VK_FALSE;
 }
 
-void Pipeline::setupViewport(VkViewport& viewport) {
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = swapChain->getExtent().width;
-	viewport.height = swapChain->getExtent().height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-}
-
-void Pipeline::setupViewportStateCreateInfo(VkPipelineViewportStateCreateInfo& createInfo, VkViewport& viewport, VkRect2D& scissor) {
-	setupViewport(viewport);
-	scissor.offset = { 0, 0 };
-	scissor.extent = swapChain->getExtent();
-
+void Pipeline::setupViewportStateCreateInfo(VkPipelineViewportStateCreateInfo& createInfo) {
+	// Both are dynamic, only their count is part of the pipeline.
 	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 	createInfo.viewportCount = 1;
-	createInfo.pViewports = &viewport;
+	createInfo.pViewports = nullptr;
 	createInfo.scissorCount = 1;
-	createInfo.pScissors = &scissor;
+	createInfo.pScissors = nullptr;
 }
 
 void Pipeline::setupRasterizationStateCreateInfo(VkPipelineRasterizationStateCreateInfo& createInfo) {
@@ -228,17 +317,19 @@ void Pipeline::setupMultisampleStateCreateInfo(VkPipelineMultisampleStateCreateI
 	createInfo.alphaToOneEnable = VK_FALSE;
 }
 
-void Pipeline::setupDepthStencilStateCreateInfo(VkPipelineDepthStencilStateCreateInfo& createInfo) {
+void Pipeline::setupDepthStencilStateCreateInfo(VkPipelineDepthStencilStateCreateInfo& createInfo, bool depthOnly) {
+	// After a prepass the depth buffer is final: shading only passes where it matches and writes nothing.
+	bool depthPrepassed = depthPrepass && !depthOnly;
 	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 	createInfo.depthTestEnable = VK_TRUE;
-	createInfo.depthWriteEnable = VK_TRUE;
-	createInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+	createInfo.depthWriteEnable = depthPrepassed ? VK_FALSE : VK_TRUE;
+	createInfo.depthCompareOp = depthPrepassed ? VK_COMPARE_OP_LESS_OR_EQUAL : VK_COMPARE_OP_LESS;
 	createInfo.depthBoundsTestEnable = VK_FALSE;
 	createInfo.stencilTestEnable = VK_FALSE;
 }
 
-void Pipeline::setupColorBlendStateCreateInfo(VkPipelineColorBlendStateCreateInfo& createInfo, VkPipelineColorBlendAttachmentState& attachment) {
-	setupColorBlendAttachmentState(attachment);
+void Pipeline::setupColorBlendStateCreateInfo(VkPipelineColorBlendStateCreateInfo& createInfo, VkPipelineColorBlendAttachmentState& attachment, bool depthOnly) {
+	setupColorBlendAttachmentState(attachment, depthOnly);
 	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
 	createInfo.logicOpEnable = VK_FALSE;
 	createInfo.logicOp = VK_LOGIC_OP_COPY;
@@ -249,8 +340,8 @@ void Pipeline::setupColorBlendStateCreateInfo(VkPipelineColorBlendStateCreateInf
 	createInfo.blendConstants[2] = 0.0f;
 	createInfo.blendConstants[3] = 0.0f;
 }
-void Pipeline::setupColorBlendAttachmentState(VkPipelineColorBlendAttachmentState& attachment) {
-	attachment.colorWriteMask =
+void Pipeline::setupColorBlendAttachmentState(VkPipelineColorBlendAttachmentState& attachment, bool depthOnly) {
+	attachment.colorWriteMask = depthOnly ? 0 :
 		VK_COLOR_COMPONENT_R_BIT |
 		VK_COLOR_COMPONENT_G_BIT |
 		VK_COLOR_COMPONENT_B_BIT |
@@ -258,13 +349,30 @@ void Pipeline::setupColorBlendAttachmentState(VkPipelineColorBlendAttachmentStat
 	attachment.blendEnable = VK_FALSE;
 }
 
+void Pipeline::checkShaderInterface(ShaderModule& shader, const std::string& filename) {
+	// A binary compiled from older sources than the descriptor set layout reads the wrong resources,
+	// so it fails its compilation instead of drawing garbage.
+	if (!shader.hasStorageBuffer(1))
+		throw std::runtime_error("Shader " + filename + " is out of date (no object buffer at binding 1), rebuild the shaders.");
+	if (!shader.hasStorageBuffer(2))
+		throw std::runtime_error("Shader " + filename + " is out of date (no instance index buffer at binding 2), rebuild the shaders.");
+	if (!shader.hasPushConstants())
+		throw std::runtime_error("Shader " + filename + " is out of date (no draw push constants), rebuild the shaders.");
+}
+
 void Pipeline::createPipelineLayout() {
 	VkPipelineLayoutCreateInfo layoutCreateInfo{};
 	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	layoutCreateInfo.setLayoutCount = 1;
 	layoutCreateInfo.pSetLayouts = &descriptorSetLayout->getLayout();
-	layoutCreateInfo.pushConstantRangeCount = 0;
-	layoutCreateInfo.pPushConstantRanges = nullptr;;
+	// 128 bytes is the smallest maxPushConstantsSize a device may report.
+	static_assert(sizeof(DrawConstants) <= 128, "DrawConstants exceed the guaranteed push constant size");
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(DrawConstants);
+	layoutCreateInfo.pushConstantRangeCount = 1;
+	layoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
 	if (vkCreatePipelineLayout(device->getDevice(), &layoutCreateInfo, nullptr, &layout) != VK_SUCCESS)
 		throw std::runtime_error("Failed to create pipeline layout");
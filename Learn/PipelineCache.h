@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "LogicalDevice.h"
+#include "Hash.h"
+
+const uint32_t PIPELINE_CACHE_FILE_MAGIC = 0x43504B56; // "VKPC"
+const uint32_t PIPELINE_CACHE_FILE_VERSION = 1;
+
+// Prepended to the driver's cache blob so truncated or corrupted files are caught before the driver sees them.
+struct PipelineCacheFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t dataSize;
+	uint64_t checksum;
+};
+
+// VkPipelineCache that is loaded from disk on creation and written back on destruction.
+// Data written by another device, driver or a damaged file is discarded and the cache starts empty.
+class PipelineCache {
+public:
+	~PipelineCache();
+	PipelineCache(LogicalDevice* device, std::string path = "pipeline.cache");
+	VkPipelineCache& getPipelineCache() { return pipelineCache; }
+	bool isWarm() { return warm; }
+	void save();
+
+private:
+	std::vector<char> loadCacheData();
+	bool isFileHeaderValid(const PipelineCacheFileHeader& header, const std::vector<char>& data);
+	bool isDeviceHeaderValid(const std::vector<char>& data);
+	void createPipelineCache(const std::vector<char>& data);
+
+	LogicalDevice* device;
+	std::string path;
+	bool warm = false;
+	VkPipelineCache pipelineCache;
+};
+
+PipelineCache::~PipelineCache() {
+	save();
+	vkDestroyPipelineCache(device->getDevice(), pipelineCache, nullptr);
+}
+
+PipelineCache::PipelineCache(LogicalDevice* inDevice, std::string inPath) {
+	device = inDevice;
+	path = inPath;
+	createPipelineCache(loadCacheData());
+}
+
+std::vector<char> PipelineCache::loadCacheData() {
+	std::vector<char> data;
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return data;
+
+	PipelineCacheFileHeader header{};
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+		std::cerr << "Pipeline cache " << path << " is truncated, discarding it.\n";
+		return data;
+	}
+	if (header.magic != PIPELINE_CACHE_FILE_MAGIC || header.version != PIPELINE_CACHE_FILE_VERSION) {
+		std::cerr << "Pipeline cache " << path << " has an unknown format, discarding it.\n";
+		return data;
+	}
+
+	// The size comes from the file, so it is checked against what the file holds before anything is allocated.
+	std::streamoff dataOffset = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streamoff remaining = file.tellg() - dataOffset;
+	if (remaining < 0 || header.dataSize > static_cast<uint64_t>(remaining)) {
+		std::cerr << "Pipeline cache " << path << " is truncated, discarding it.\n";
+		return data;
+	}
+	file.seekg(dataOffset);
+
+	data.resize(static_cast<size_t>(header.dataSize));
+	if (!file.read(data.data(), data.size()) || !isFileHeaderValid(header, data) || !isDeviceHeaderValid(data))
+		data.clear();
+	return data;
+}
+
+bool PipelineCache::isFileHeaderValid(const PipelineCacheFileHeader& header, const std::vector<char>& data) {
+	if (hashBytes(data.data(), data.size()) != header.checksum) {
+		std::cerr << "Pipeline cache " << path << " failed its checksum, discarding it.\n";
+		return false;
+	}
+	return true;
+}
+
+bool PipelineCache::isDeviceHeaderValid(const std::vector<char>& data) {
+	// Layout of VK_PIPELINE_CACHE_HEADER_VERSION_ONE: size, version, vendor, device, then the cache UUID.
+	const size_t headerSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+	if (data.size() < headerSize)
+		return false;
+
+	uint32_t fields[4];
+	memcpy(fields, data.data(), sizeof(fields));
+	const uint8_t* uuid = reinterpret_cast<const uint8_t*>(data.data()) + sizeof(fields);
+
+	VkPhysicalDeviceProperties& properties = device->getPhysicalDevice()->getProperties();
+	if (fields[0] < headerSize || fields[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+		fields[2] != properties.vendorID || fields[3] != properties.deviceID ||
+		memcmp(uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+		std::cerr << "Pipeline cache " << path << " was written by another device or driver, discarding it.\n";
+		return false;
+	}
+	return true;
+}
+
+void PipelineCache::createPipelineCache(const std::vector<char>& data) {
+	VkPipelineCacheCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = data.size();
+	createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	if (vkCreatePipelineCache(device->getDevice(), &createInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create pipeline cache.");
+	warm = !data.empty();
+}
+
+void PipelineCache::save() {
+	size_t dataSize = 0;
+	if (vkGetPipelineCacheData(device->getDevice(), pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+		return;
+	std::vector<char> data(dataSize);
+	if (vkGetPipelineCacheData(device->getDevice(), pipelineCache, &dataSize, data.data()) != VK_SUCCESS)
+		return;
+	data.resize(dataSize);
+
+	PipelineCacheFileHeader header{};
+	header.magic = PIPELINE_CACHE_FILE_MAGIC;
+	header.version = PIPELINE_CACHE_FILE_VERSION;
+	header.dataSize = dataSize;
+	header.checksum = hashBytes(data.data(), data.size());
+
+	// Written next to the target and swapped in, so a crash mid-write never leaves a half file behind.
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open() ||
+			!file.write(reinterpret_cast<const char*>(&header), sizeof(header)) ||
+			!file.write(data.data(), data.size())) {
+			std::cerr << "Failed to write pipeline cache " << tempPath << ".\n";
+			return;
+		}
+	}
+	std::remove(path.c_str());
+	if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+		std::cerr << "Failed to replace pipeline cache " << path << ".\n";
+}
@@ -6,17 +6,17 @@
 class RenderPass {
 public:
 	~RenderPass();
-	RenderPass(LogicalDevice* logicalDevice, SwapChain* swapChain, ColorResource* colorResource, DepthResource* depthResource);
+	RenderPass(LogicalDevice* logicalDevice, SwapChain* swapChain, DepthResource* depthResource);
 	void createRenderPass();
 	VkRenderPass& getRenderPass() { return renderPass; }
-	ColorResource* getColorResourceRef() { return colorResource; }
-	DepthResource* getDepthResourceRef() { return depthResource; }
+	VkFormat getColorFormat() { return colorFormat; }
+	VkFormat getDepthFormat() { return depthFormat; }
 	
 private:
 	LogicalDevice* device;
-	SwapChain* swapChain;
-	ColorResource* colorResource;
-	DepthResource* depthResource;
+	VkFormat colorFormat;
+	VkFormat depthFormat;
+	bool presentable;
 	VkRenderPass renderPass;
 
 };
@@ -25,28 +25,30 @@ RenderPass::~RenderPass() {
 	vkDestroyRenderPass(device->getDevice(), renderPass, nullptr);
 }
 
-RenderPass::RenderPass(LogicalDevice* inDevice, SwapChain* inSwapChain, ColorResource* inColorResource, DepthResource* inDepthResource) {
+RenderPass::RenderPass(LogicalDevice* inDevice, SwapChain* inSwapChain, DepthResource* inDepthResource) {
 	device = inDevice;
-	swapChain = inSwapChain;
-	colorResource = inColorResource;
-	depthResource = inDepthResource;
+	// Only formats are kept: attachments sized to the swap chain are recreated on resize, the render pass
+	// only when the swap chain comes back with another format.
+	colorFormat = inSwapChain->getFormat();
+	depthFormat = inDepthResource->getFormat();
+	presentable = !inSwapChain->isHeadless();
 	createRenderPass();
 }
 
 void RenderPass::createRenderPass() {
 	std::array<VkAttachmentDescription, 2> attachments;
 
-	attachments[0].format = swapChain->getFormat();
+	attachments[0].format = colorFormat;
 	attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
 	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 	attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	attachments[0].finalLayout = presentable ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
 	attachments[0].flags = 0;
 
-	attachments[1].format = depthResource->getFormat();
+	attachments[1].format = depthFormat;
 	attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
 	attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 	attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "DrawCommands.h"
+
+// Fields of a sort key, from the most to the least significant bits. Draws sort by pass first, then by
+// the state they need, so equal state ends up adjacent and is bound once, and front to back last.
+enum RenderPassOrder {
+	RENDER_PASS_DEPTH_PREPASS,
+	RENDER_PASS_SHADING,
+};
+
+const uint32_t RENDER_KEY_PASS_SHIFT = 62;
+const uint32_t RENDER_KEY_PIPELINE_SHIFT = 56;
+const uint32_t RENDER_KEY_INDEX_TYPE_SHIFT = 55;
+const uint32_t RENDER_KEY_MATERIAL_SHIFT = 47;
+const uint32_t RENDER_KEY_LOD_SHIFT = 43;
+const uint32_t RENDER_KEY_DEPTH_BITS = 16;
+
+// Draws of the frame ordered by a packed 64-bit key. Each submitted draw keeps its key and the index of
+// its payload; only those pairs are radix sorted, the draws are gathered into key order afterwards.
+// The sort is stable, so draws with equal keys keep the order they were submitted in.
+class RenderQueue {
+public:
+	static uint64_t makeKey(RenderPassOrder pass, uint32_t pipeline, VkIndexType indexType, uint32_t material, uint32_t lod, float depth);
+
+	void clear();
+	void push(uint64_t key, const DrawItem& item);
+	void sort();
+	const std::vector<DrawItem>& getSortedItems() { return sortedItems; }
+	uint32_t getSize() { return static_cast<uint32_t>(entries.size()); }
+
+private:
+	struct Entry {
+		uint64_t key;
+		uint32_t item;
+	};
+
+	std::vector<Entry> entries;
+	std::vector<Entry> scratch;
+	std::vector<DrawItem> items;
+	std::vector<DrawItem> sortedItems;
+};
+
+uint64_t RenderQueue::makeKey(RenderPassOrder pass, uint32_t pipeline, VkIndexType indexType, uint32_t material, uint32_t lod, float depth) {
+	// Depth is the distance to the camera over the far plane, quantized so near draws come first.
+	const uint32_t depthMax = (1u << RENDER_KEY_DEPTH_BITS) - 1;
+	uint32_t depthBucket = static_cast<uint32_t>(std::min(std::max(depth, 0.0f), 1.0f) * depthMax);
+	return (static_cast<uint64_t>(pass & 0x3) << RENDER_KEY_PASS_SHIFT) |
+		(static_cast<uint64_t>(pipeline & 0x3f) << RENDER_KEY_PIPELINE_SHIFT) |
+		(static_cast<uint64_t>(indexType == VK_INDEX_TYPE_UINT32 ? 1 : 0) << RENDER_KEY_INDEX_TYPE_SHIFT) |
+		(static_cast<uint64_t>(material & 0xff) << RENDER_KEY_MATERIAL_SHIFT) |
+		(static_cast<uint64_t>(lod & 0xf) << RENDER_KEY_LOD_SHIFT) |
+		depthBucket;
+}
+
+void RenderQueue::clear() {
+	entries.clear();
+	items.clear();
+}
+
+void RenderQueue::push(uint64_t key, const DrawItem& item) {
+	entries.push_back({ key, static_cast<uint32_t>(items.size()) });
+	items.push_back(item);
+}
+
+void RenderQueue::sort() {
+	// Least significant digit first, a byte per pass. All histograms are built in one walk over the keys,
+	// and a byte that is the same in every key leaves the order unchanged, so its pass is skipped.
+	const uint32_t digitCount = sizeof(uint64_t);
+	uint32_t histograms[digitCount][256] = {};
+	for (const Entry& entry : entries)
+		for (uint32_t digit = 0; digit < digitCount; ++digit)
+			histograms[digit][(entry.key >> (8 * digit)) & 0xff]++;
+
+	size_t count = entries.size();
+	scratch.resize(count);
+	for (uint32_t digit = 0; digit < digitCount && count > 0; ++digit) {
+		uint32_t* histogram = histograms[digit];
+		if (histogram[(entries[0].key >> (8 * digit)) & 0xff] == count)
+			continue;
+		uint32_t offset = 0;
+		for (uint32_t bucket = 0; bucket < 256; ++bucket) {
+			uint32_t bucketSize = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketSize;
+		}
+		for (const Entry& entry : entries)
+			scratch[histogram[(entry.key >> (8 * digit)) & 0xff]++] = entry;
+		entries.swap(scratch);
+	}
+
+	sortedItems.resize(count);
+	for (size_t i = 0; i < count; ++i)
+		sortedItems[i] = items[entries[i].item];
+}
@@ -1,22 +1,41 @@
 #pragma once
 
+#include <algorithm>
 #include <fstream>
+#include <map>
 #include <string>
 #include "LogicalDevice.h"
 
+// Loads a SPIR-V binary. The resource variables it declares are read from the binary as well,
+// so a pipeline can reject a shader compiled from older sources than the layout it is built with.
 class ShaderModule {
 public:
 	~ShaderModule();
 	ShaderModule(LogicalDevice* device, const std::string filename);
 	VkShaderModule& getModule() { return shaderModule; }
+	/** @brief Whether the shader declares a storage buffer at the binding */
+	bool hasStorageBuffer(uint32_t binding, uint32_t set = 0);
+	/** @brief Whether the shader declares a push constant block */
+	bool hasPushConstants();
 
 private:
+	struct Variable {
+		uint32_t storageClass;
+		uint32_t type;
+		uint32_t set = 0;
+		uint32_t binding = UINT32_MAX;
+	};
+
 	void readFile(const std::string& filename);
 	void createShaderModule();
+	void reflect();
 
 	LogicalDevice* device;
 	std::vector<char> code;
 	VkShaderModule shaderModule;
+	std::vector<Variable> variables;
+	// Struct types decorated as old-style storage buffer blocks
+	std::vector<uint32_t> bufferBlocks;
 };
 
 ShaderModule::~ShaderModule() {
@@ -28,6 +47,7 @@ ShaderModule::ShaderModule(LogicalDevice* inDevice, const std::string filename)
 	device = inDevice;
 	readFile(filename);
 	createShaderModule();
+	reflect();
 }
 
 void ShaderModule::readFile(const std::string& filename) {
@@ -50,4 +70,76 @@ void ShaderModule::createShaderModule() {
 	
 	if (vkCreateShaderModule(device->getDevice(), &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
 		throw std::runtime_error("Failed to create shader module.");
-}
\ No newline at end of file
+}
+
+void ShaderModule::reflect() {
+	// Only the instructions naming resource variables are read: OpDecorate, OpTypePointer and OpVariable.
+	const uint32_t magic = 0x07230203;
+	const uint32_t opDecorate = 71, opTypePointer = 32, opVariable = 59;
+	const uint32_t decorationBufferBlock = 3, decorationBinding = 33, decorationDescriptorSet = 34;
+	const uint32_t* words = reinterpret_cast<const uint32_t*>(code.data());
+	size_t wordCount = code.size() / sizeof(uint32_t);
+	if (wordCount < 5 || words[0] != magic)
+		throw std::runtime_error("Failed to read shader module, not SPIR-V.");
+
+	std::map<uint32_t, uint32_t> pointees;
+	std::map<uint32_t, std::pair<uint32_t, uint32_t>> decorations;
+	std::map<uint32_t, Variable> variablesById;
+	for (size_t i = 5; i < wordCount;) {
+		uint32_t opcode = words[i] & 0xffff;
+		uint32_t length = words[i] >> 16;
+		if (length == 0 || i + length > wordCount)
+			throw std::runtime_error("Failed to read shader module, truncated instruction.");
+		const uint32_t* operands = words + i + 1;
+		if (opcode == opDecorate && length >= 3) {
+			if (operands[1] == decorationBufferBlock)
+				bufferBlocks.push_back(operands[0]);
+			else if (operands[1] == decorationBinding && length >= 4)
+				decorations[operands[0]].second = operands[2] + 1;
+			else if (operands[1] == decorationDescriptorSet && length >= 4)
+				decorations[operands[0]].first = operands[2];
+		}
+		else if (opcode == opTypePointer && length >= 4)
+			pointees[operands[0]] = operands[2];
+		else if (opcode == opVariable && length >= 4) {
+			Variable& variable = variablesById[operands[1]];
+			variable.storageClass = operands[2];
+			variable.type = pointees.count(operands[0]) ? pointees[operands[0]] : 0;
+		}
+		i += length;
+	}
+
+	// Decorations come before the variables they name, so they are matched up at the end.
+	for (auto& entry : variablesById) {
+		auto decoration = decorations.find(entry.first);
+		if (decoration != decorations.end()) {
+			entry.second.set = decoration->second.first;
+			if (decoration->second.second > 0)
+				entry.second.binding = decoration->second.second - 1;
+		}
+		variables.push_back(entry.second);
+	}
+}
+
+bool ShaderModule::hasStorageBuffer(uint32_t binding, uint32_t set) {
+	// Storage buffers are StorageBuffer variables from SPIR-V 1.3 on, Uniform variables of a BufferBlock struct before.
+	const uint32_t storageClassUniform = 2, storageClassStorageBuffer = 12;
+	for (const Variable& variable : variables) {
+		if (variable.set != set || variable.binding != binding)
+			continue;
+		if (variable.storageClass == storageClassStorageBuffer)
+			return true;
+		if (variable.storageClass == storageClassUniform &&
+			std::find(bufferBlocks.begin(), bufferBlocks.end(), variable.type) != bufferBlocks.end())
+			return true;
+	}
+	return false;
+}
+
+bool ShaderModule::hasPushConstants() {
+	const uint32_t storageClassPushConstant = 9;
+	for (const Variable& variable : variables)
+		if (variable.storageClass == storageClassPushConstant)
+			return true;
+	return false;
+}
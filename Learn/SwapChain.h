@@ -8,7 +8,9 @@
 class SwapChain {
 public:
 	~SwapChain();
-	SwapChain(LogicalDevice* device, Window* window);
+	SwapChain(LogicalDevice* device, Window* window, SwapChain* oldSwapChain = nullptr);
+	SwapChain(LogicalDevice* device, VkExtent2D extent, uint32_t imageCount);
+	bool isHeadless() { return window == nullptr; }
 	VkSwapchainKHR& getSwapChain() { return swapChain; }
 	VkFormat getFormat() { return format; }
 	VkExtent2D getExtent() { return extent; }
@@ -16,7 +18,7 @@ public:
 	ImageResource* getSwapChainResourcesRef(uint32_t index) { return imageResources[index]; }
 
 private:
-	void createSwapChain();
+	void createSwapChain(SwapChain* oldSwapChain);
 
 	void selectPresentMode();
 	void selectSurfaceFormat();
@@ -24,6 +26,7 @@ private:
 	void retrieveSwapChainImageCount();
 	void createSwapChainImages();
 	void createSwapChainImageViews();
+	void createOffscreenImages();
 
 
 	LogicalDevice* device;
@@ -45,22 +48,40 @@ private:
 };
 
 SwapChain::~SwapChain() {
+	if (isHeadless()) {
+		for (uint32_t i = 0; i < imageCount; ++i)
+			delete imageResources[i];
+		return;
+	}
 	for (uint32_t i = 0; i < imageCount; ++i)
 		vkDestroyImageView(device->getDevice(), imageResources[i]->getImageView(), nullptr);
 	vkDestroySwapchainKHR(device->getDevice(), swapChain, nullptr);
 }
 
-SwapChain::SwapChain(LogicalDevice* inDevice, Window* inWindow) {
+SwapChain::SwapChain(LogicalDevice* inDevice, Window* inWindow, SwapChain* oldSwapChain) {
 	device = inDevice;
 	window = inWindow;
 	supportDetails = device->getPhysicalDevice()->retrieveSwapChainSupportDetails(device->getPhysicalDevice()->getDevice(), window);
 
-	createSwapChain();
+	createSwapChain(oldSwapChain);
 	createSwapChainImages();
 	createSwapChainImageViews();
 }
 
-void SwapChain::createSwapChain() {
+SwapChain::SwapChain(LogicalDevice* inDevice, VkExtent2D inExtent, uint32_t inImageCount) {
+	device = inDevice;
+	window = nullptr;
+	swapChain = VK_NULL_HANDLE;
+	extent = inExtent;
+	imageCount = inImageCount;
+	format = VK_FORMAT_R8G8B8A8_UNORM;
+	colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+	presentMode = VK_PRESENT_MODE_FIFO_KHR;
+
+	createOffscreenImages();
+}
+
+void SwapChain::createSwapChain(SwapChain* oldSwapChain) {
 	selectPresentMode();
 	selectSurfaceFormat();
 	retrieveExtent();
@@ -92,7 +113,8 @@ void SwapChain::createSwapChain() {
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = presentMode;
 	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	// Handing over the old swap chain lets the driver reuse its resources and keep presenting while we switch.
+	createInfo.oldSwapchain = oldSwapChain != nullptr ? oldSwapChain->getSwapChain() : VK_NULL_HANDLE;
 
 	if (vkCreateSwapchainKHR(device->getDevice(), &createInfo, nullptr, &swapChain) != VK_SUCCESS)
 		throw std::runtime_error("Failed to create swap chain.");
@@ -153,4 +175,18 @@ void SwapChain::createSwapChainImages() {
 void SwapChain::createSwapChainImageViews() {
 	for (uint32_t i = 0; i < imageCount; ++i)
 		imageResources[i]->createImageView(VK_IMAGE_ASPECT_COLOR_BIT);
+}
+
+void SwapChain::createOffscreenImages() {
+	imageResources.resize(imageCount);
+	for (uint32_t i = 0; i < imageCount; ++i) {
+		imageResources[i] = new ImageResource(device, extent.width, extent.height, 1);
+		imageResources[i]->createImageResource(
+			VK_SAMPLE_COUNT_1_BIT,
+			format,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT);
+	}
 }
\ No newline at end of file
@@ -5,26 +5,25 @@
 
 #include "ImageResource.h"
 #include "Buffer.h"
+#include "UploadManager.h"
 
 class Texture : public ImageResource {
 public:
 	~Texture();
-	Texture(LogicalDevice* device, std::string path, CommandPool* commandPool);
+	Texture(LogicalDevice* device, std::string path, UploadManager* uploadManager);
 	VkSampler& getSampler() { return sampler; }
 
 private:
 	void loadTexture(std::string path);
-	void copyOriginalImageToBuffer();
-	void copyBufferToVulkanImage();
+	void copyOriginalImageToVulkanImage();
 
-	void generateMipmaps();
+	void generateMipmaps(VkCommandBuffer commandBuffer);
 	void checkImageFormatBlittingSupport();
 
 	void createSampler();
 
 	LogicalDevice* device;
-	CommandPool* commandPool;
-	Buffer* stagingBuffer;
+	UploadManager* uploadManager;
 
 	stbi_uc* pixels = 0;
 	VkDeviceSize imageSize;
@@ -36,24 +35,22 @@ Texture::~Texture() {
 	vkDestroySampler(device->getDevice(), sampler, nullptr);
 }
 
-Texture::Texture(LogicalDevice* inDevice, std::string path, CommandPool* inCommandPool) : ImageResource(inDevice) {
+Texture::Texture(LogicalDevice* inDevice, std::string path, UploadManager* inUploadManager) : ImageResource(inDevice) {
 	device = inDevice;
-	commandPool = inCommandPool;
+	uploadManager = inUploadManager;
 	loadTexture(path);
 
-	copyOriginalImageToBuffer();
-
 	createImageResource(VK_SAMPLE_COUNT_1_BIT, 
 		VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
 		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
-	transitImageLayout(commandPool, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-	
-	copyBufferToVulkanImage();
-	delete stagingBuffer;
-	stagingBuffer = nullptr;
 
-	generateMipmaps();
+	// The copy may flush the current batch to make staging room, so fetch the command buffer after it.
+	// Blits need a graphics queue, so the mip chain is built on the graphics side of the batch.
+	transitImageLayout(uploadManager->getCommandBuffer(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	copyOriginalImageToVulkanImage();
+	uploadManager->transferImageOwnership(image, { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 }, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	generateMipmaps(uploadManager->getGraphicsCommandBuffer());
 	createSampler();
 }
 
@@ -69,42 +66,15 @@ void Texture::loadTexture(std::string path) {
 	height = static_cast<uint32_t>(texHeight);
 }
 
-void Texture::copyOriginalImageToBuffer() {
-	stagingBuffer = new Buffer(device, imageSize,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-
-	stagingBuffer->copyDataToBuffer(pixels);
-
+void Texture::copyOriginalImageToVulkanImage() {
+	uploadManager->uploadToImage(image, pixels, imageSize, width, height);
 	stbi_image_free(pixels);
+	pixels = nullptr;
 }
 
-void Texture::copyBufferToVulkanImage() {
-	CommandBuffer commandBuffer(device, commandPool);
-	commandBuffer.beginSingalTimeCommands();
-
-	VkBufferImageCopy region{};
-	region.bufferOffset = 0;
-	region.bufferRowLength = 0;
-	region.bufferImageHeight = 0;
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = 1;
-	region.imageOffset = { 0, 0, 0 };
-	region.imageExtent = { width, height, 1 };
-
-	vkCmdCopyBufferToImage(commandBuffer.getCommandBuffer(), stagingBuffer->getBuffer(), image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-	commandBuffer.endSingalTimeCommands();
-}
-
-void Texture::generateMipmaps() {
+void Texture::generateMipmaps(VkCommandBuffer commandBuffer) {
 	checkImageFormatBlittingSupport();
 
-	CommandBuffer commandBuffer(device, commandPool);
-	commandBuffer.beginSingalTimeCommands();
-
 	VkImageMemoryBarrier barrier = {};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 	barrier.image = image;
@@ -125,7 +95,7 @@ void Texture::generateMipmaps() {
 		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 
-		vkCmdPipelineBarrier(commandBuffer.getCommandBuffer(),
+		vkCmdPipelineBarrier(commandBuffer,
 			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
 			0, nullptr,
 			0, nullptr,
@@ -145,7 +115,7 @@ void Texture::generateMipmaps() {
 		blit.dstSubresource.baseArrayLayer = 0;
 		blit.dstSubresource.layerCount = 1;
 
-		vkCmdBlitImage(commandBuffer.getCommandBuffer(),
+		vkCmdBlitImage(commandBuffer,
 			image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
 			image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			1, &blit,
@@ -156,7 +126,7 @@ void Texture::generateMipmaps() {
 		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-		vkCmdPipelineBarrier(commandBuffer.getCommandBuffer(),
+		vkCmdPipelineBarrier(commandBuffer,
 			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
 			0, nullptr,
 			0, nullptr,
@@ -172,13 +142,11 @@ void Texture::generateMipmaps() {
 	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-	vkCmdPipelineBarrier(commandBuffer.getCommandBuffer(),
+	vkCmdPipelineBarrier(commandBuffer,
 		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
 		0, nullptr,
 		0, nullptr,
 		1, &barrier);
-
-	commandBuffer.endSingalTimeCommands();
 }
 
 void Texture::checkImageFormatBlittingSupport() {
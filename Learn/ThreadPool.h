@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Counts the outstanding jobs of one caller so it can wait for its own work
+// without also waiting for unrelated jobs sharing the pool.
+// The first exception thrown by one of its jobs is rethrown by wait().
+class JobGroup {
+public:
+	void add();
+	void done(std::exception_ptr error = nullptr);
+	void wait();
+
+private:
+	std::mutex mutex;
+	std::condition_variable finished;
+	uint32_t pending = 0;
+	std::exception_ptr error;
+};
+
+void JobGroup::add() {
+	std::lock_guard<std::mutex> lock(mutex);
+	pending++;
+}
+
+void JobGroup::done(std::exception_ptr jobError) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (jobError && !error)
+		error = jobError;
+	if (--pending == 0)
+		finished.notify_all();
+}
+
+void JobGroup::wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [this] { return pending == 0; });
+	if (error) {
+		std::exception_ptr jobError = error;
+		error = nullptr;
+		std::rethrow_exception(jobError);
+	}
+}
+
+// Fixed set of worker threads fed from one job queue.
+// wait() blocks until every job enqueued so far has finished. A throwing job never takes its
+// worker down: grouped jobs report to their group, the first error of the others is rethrown by wait().
+class ThreadPool {
+public:
+	~ThreadPool();
+	ThreadPool(uint32_t threadCount = defaultThreadCount());
+	uint32_t getThreadCount() { return static_cast<uint32_t>(workers.size()); }
+	void enqueue(std::function<void()> job);
+	void enqueue(JobGroup& group, std::function<void()> job);
+	void wait();
+
+	static uint32_t defaultThreadCount();
+
+private:
+	void workerLoop();
+
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::condition_variable jobsFinished;
+	uint32_t pendingJobs = 0;
+	std::exception_ptr error;
+	bool stopping = false;
+};
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobAvailable.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+	threadCount = std::max(threadCount, 1u);
+	for (uint32_t i = 0; i < threadCount; ++i)
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+uint32_t ThreadPool::defaultThreadCount() {
+	// Leave one core to the thread that submits and presents.
+	uint32_t cores = std::thread::hardware_concurrency();
+	return cores > 1 ? cores - 1 : 1;
+}
+
+void ThreadPool::enqueue(std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push(std::move(job));
+		pendingJobs++;
+	}
+	jobAvailable.notify_one();
+}
+
+void ThreadPool::enqueue(JobGroup& group, std::function<void()> job) {
+	group.add();
+	enqueue([&group, job] {
+		std::exception_ptr error;
+		try {
+			job();
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		group.done(error);
+	});
+}
+
+void ThreadPool::wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	jobsFinished.wait(lock, [this] { return pendingJobs == 0; });
+	if (error) {
+		std::exception_ptr jobError = error;
+		error = nullptr;
+		std::rethrow_exception(jobError);
+	}
+}
+
+void ThreadPool::workerLoop() {
+	while (true) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if (stopping && jobs.empty())
+				return;
+			job = std::move(jobs.front());
+			jobs.pop();
+		}
+
+		std::exception_ptr jobError;
+		try {
+			job();
+		}
+		catch (...) {
+			jobError = std::current_exception();
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (jobError && !error)
+			error = jobError;
+		if (--pendingJobs == 0)
+			jobsFinished.notify_all();
+	}
+}
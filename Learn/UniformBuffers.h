@@ -7,6 +7,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtx/hash.hpp>
 #include <cstdlib>
+#include <cstring>
 
 #include "Buffer.h"
 #include "SwapChain.h"
@@ -18,73 +19,86 @@ struct UniformBufferObject {
 	alignas(16) glm::vec4 lightPos[3];
 };
 
-struct DynamicUniformObject {
-	glm::mat4* model = nullptr;
-};
-
+// One persistently mapped buffer split into a region per frame that can be in flight.
+// Each frame bump-allocates its data from the start of its region: the per-frame
+// UniformBufferObject first, then the instance list: the object index of every instance drawn this frame,
+// which shaders read as a storage buffer indexed by gl_InstanceIndex.
 class UniformBuffers {
 public:
 	~UniformBuffers();
-	UniformBuffers(LogicalDevice* device, SwapChain* swapChain);
-	Buffer* getBufferRef(size_t index) { return buffers[index]; }
-	Buffer* getDynamicBufferRef(size_t index) { return dynamicUboBuffers[index]; }
-	uint32_t getDynamicAlignment() { return dynamicAlignment; }
+	UniformBuffers(LogicalDevice* device, uint32_t regionCount, uint32_t instanceCapacity);
+	Buffer* getBufferRef() { return buffer; }
+	uint32_t getInstanceCapacity() { return instanceCapacity; }
+	VkDeviceSize getRegionOffset(uint32_t region) { return region * regionSize; }
+	/** @brief Start of the instance list within a region, the second allocation of every frame */
+	VkDeviceSize getInstanceArrayOffset() { return frameDataSize; }
+	VkDeviceSize getInstanceArraySize() { return instanceCapacity * sizeof(uint32_t); }
 
-	UniformBufferObject ubo{};
-	DynamicUniformObject dynamicUbo{};
+	void beginFrame(uint32_t region);
+	void* allocate(VkDeviceSize size, uint32_t& offset);
+	uint32_t push(const void* data, VkDeviceSize size);
+	void flush();
 
 private:
-	void createUniformBuffers();
-	void createDynamicUniformBuffers();
+	void createRingBuffer();
+	VkDeviceSize alignUp(VkDeviceSize size) { return (size + minAlignment - 1) & ~(minAlignment - 1); }
 
 	LogicalDevice* device;
-	SwapChain* swapChain;
-	std::vector<Buffer*> buffers;
-	std::vector<Buffer*> dynamicUboBuffers;
-	size_t dynamicAlignment;
+	uint32_t regionCount;
+	uint32_t instanceCapacity;
+	Buffer* buffer;
 
+	VkDeviceSize minAlignment;
+	VkDeviceSize frameDataSize;
+	VkDeviceSize regionSize;
+	VkDeviceSize regionBase = 0;
+	VkDeviceSize head = 0;
 };
 
 UniformBuffers::~UniformBuffers() {
-	for (uint32_t i = 0; i < swapChain->getImageCount(); ++i) {
-		delete buffers[i];
-		delete dynamicUboBuffers[i];
-	}
-	if (dynamicUbo.model)
-		_aligned_free(dynamicUbo.model);
+	delete buffer;
 }
 
-UniformBuffers::UniformBuffers(LogicalDevice* inDevice, SwapChain* inSwapChain) {
+UniformBuffers::UniformBuffers(LogicalDevice* inDevice, uint32_t inRegionCount, uint32_t inInstanceCapacity) {
 	device = inDevice;
-	swapChain = inSwapChain;
-	buffers.resize(swapChain->getImageCount());
-	dynamicUboBuffers.resize(swapChain->getImageCount());
-	createUniformBuffers();
-	createDynamicUniformBuffers();
+	regionCount = inRegionCount;
+	instanceCapacity = inInstanceCapacity;
+	createRingBuffer();
+}
+
+void UniformBuffers::createRingBuffer() {
+	const VkPhysicalDeviceLimits& limits = device->getPhysicalDevice()->getProperties().limits;
+	minAlignment = std::max(std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment), VkDeviceSize(16));
+	frameDataSize = alignUp(sizeof(UniformBufferObject));
+	regionSize = alignUp(getInstanceArrayOffset() + getInstanceArraySize());
+
+	buffer = new Buffer(device, regionSize * regionCount,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	if (buffer->getMappedData() == nullptr)
+		throw std::runtime_error("Failed to map uniform ring buffer.");
+}
+
+void UniformBuffers::beginFrame(uint32_t region) {
+	regionBase = getRegionOffset(region);
+	head = 0;
 }
 
-void UniformBuffers::createUniformBuffers() {
-	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+void* UniformBuffers::allocate(VkDeviceSize size, uint32_t& offset) {
+	if (head + size > regionSize)
+		throw std::runtime_error("Uniform ring buffer region overflow.");
+	offset = static_cast<uint32_t>(head);
+	head += alignUp(size);
+	return static_cast<char*>(buffer->getMappedData()) + regionBase + offset;
+}
 
-	for (size_t i = 0; i < buffers.size(); ++i) {
-		buffers[i] = new Buffer(device, bufferSize,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-	}
+uint32_t UniformBuffers::push(const void* data, VkDeviceSize size) {
+	uint32_t offset;
+	memcpy(allocate(size, offset), data, static_cast<size_t>(size));
+	return offset;
 }
 
-void UniformBuffers::createDynamicUniformBuffers() {
-	size_t minUboAlighment = device->getPhysicalDevice()->getProperties().limits.minUniformBufferOffsetAlignment;
-	dynamicAlignment = sizeof(glm::mat4);
-	if (minUboAlighment > 0)
-		dynamicAlignment = (dynamicAlignment + minUboAlighment - 1) & ~(minUboAlighment - 1);
-
-	size_t bufferSize = 3 * dynamicAlignment;
-	dynamicUbo.model = (glm::mat4*)_aligned_malloc(bufferSize, dynamicAlignment);
-	assert(dynamicUbo.model);
-	for (size_t i = 0; i < dynamicUboBuffers.size(); ++i) {		
-		dynamicUboBuffers[i] = new Buffer(device, bufferSize,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-	}
+void UniformBuffers::flush() {
+	if (head > 0)
+		device->getAllocator()->flush(buffer->getAllocation(), regionBase, head);
 }
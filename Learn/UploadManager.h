@@ -0,0 +1,411 @@
+#pragma once
+
+#include <cstring>
+#include <deque>
+#include "LogicalDevice.h"
+#include "CommandPool.h"
+#include "CommandBuffer.h"
+#include "Buffer.h"
+
+typedef uint64_t UploadTicket;
+
+const VkDeviceSize DEFAULT_STAGING_SIZE = 32ull * 1024 * 1024;
+
+// Collects buffer/image uploads and layout transitions into one command buffer per batch.
+// Staging data lives in a persistently mapped ring that is recycled as batches retire;
+// uploads larger than half the ring get a temporary staging buffer instead.
+// submit() hands back a ticket that can be polled or waited on; nothing here waits for the queue to go idle.
+// When the device exposes a separate transfer family the copies run there, and a second command buffer on
+// the graphics queue waits on the copies. Long-lived buffers that are written again after the graphics
+// queue has used them are created with getSharingFamilies() and need no hand-over. Any other buffer
+// destination is released to the graphics family as a whole and acquired there, so it must not have
+// been used on the graphics queue before its upload.
+class UploadManager {
+public:
+	~UploadManager();
+	UploadManager(LogicalDevice* device, VkDeviceSize stagingSize = DEFAULT_STAGING_SIZE);
+	VkCommandBuffer getCommandBuffer();
+	VkCommandBuffer getGraphicsCommandBuffer();
+	bool hasDedicatedQueue() { return dedicatedQueue; }
+	/** @brief Queue families a buffer must be shared between to be written here while it is in use for rendering */
+	std::vector<uint32_t> getSharingFamilies();
+	void transferImageOwnership(VkImage image, VkImageSubresourceRange range, VkImageLayout layout);
+	void uploadToBuffer(Buffer* dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+	void uploadToImage(VkImage dstImage, const void* data, VkDeviceSize size, uint32_t width, uint32_t height);
+	UploadTicket submit();
+	bool isComplete(UploadTicket ticket);
+	void wait(UploadTicket ticket);
+	void waitIdle() { wait(lastSubmittedTicket); }
+
+private:
+	struct Batch {
+		CommandBuffer* commandBuffer = nullptr;
+		CommandBuffer* graphicsCommandBuffer = nullptr;
+		VkSemaphore semaphore = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		UploadTicket ticket = 0;
+		VkDeviceSize stagingBytes = 0;
+		std::vector<Buffer*> temporaryBuffers;
+		std::vector<VkBufferMemoryBarrier> bufferTransfers;
+	};
+
+	void createStagingRing();
+	Batch* acquireBatch();
+	void retireBatch(Batch* batch);
+	void retireCompletedBatches();
+	void recordBufferOwnershipTransfers(Batch* batch);
+	void recordEndOfBatchBarrier(VkCommandBuffer commandBuffer);
+	void submitBatch(Batch* batch);
+	VkDeviceSize allocateStaging(VkDeviceSize size, Buffer*& stagingBuffer, void*& mapped);
+
+	LogicalDevice* device;
+	CommandPool* commandPool;
+	CommandPool* graphicsCommandPool = nullptr;
+	bool dedicatedQueue;
+	uint32_t transferFamily;
+	uint32_t graphicFamily;
+	Buffer* stagingRing;
+	VkDeviceSize stagingSize;
+	VkDeviceSize stagingHead = 0;
+	VkDeviceSize stagingUsed = 0;
+
+	Batch* recording = nullptr;
+	std::deque<Batch*> inFlight;
+	std::vector<Batch*> freeBatches;
+
+	UploadTicket lastSubmittedTicket = 0;
+	UploadTicket completedTicket = 0;
+};
+
+UploadManager::~UploadManager() {
+	if (recording != nullptr)
+		submit();
+	waitIdle();
+	for (auto batch : freeBatches) {
+		delete batch->commandBuffer;
+		delete batch->graphicsCommandBuffer;
+		if (batch->semaphore != VK_NULL_HANDLE)
+			vkDestroySemaphore(device->getDevice(), batch->semaphore, nullptr);
+		vkDestroyFence(device->getDevice(), batch->fence, nullptr);
+		delete batch;
+	}
+	delete stagingRing;
+	delete graphicsCommandPool;
+	delete commandPool;
+}
+
+UploadManager::UploadManager(LogicalDevice* inDevice, VkDeviceSize inStagingSize) {
+	device = inDevice;
+	stagingSize = inStagingSize;
+	dedicatedQueue = device->hasDedicatedTransferQueue();
+	transferFamily = device->getPhysicalDevice()->getTransferQueueIndex();
+	graphicFamily = device->getPhysicalDevice()->getGraphicQueueIndex();
+	commandPool = new CommandPool(device, transferFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	if (dedicatedQueue)
+		graphicsCommandPool = new CommandPool(device, graphicFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	createStagingRing();
+}
+
+void UploadManager::createStagingRing() {
+	stagingRing = new Buffer(device, stagingSize,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+UploadManager::Batch* UploadManager::acquireBatch() {
+	Batch* batch;
+	if (!freeBatches.empty()) {
+		batch = freeBatches.back();
+		freeBatches.pop_back();
+		vkResetFences(device->getDevice(), 1, &batch->fence);
+	}
+	else {
+		batch = new Batch();
+		batch->commandBuffer = new CommandBuffer(device, commandPool);
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(device->getDevice(), &fenceInfo, nullptr, &batch->fence) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create upload fence.");
+
+		if (dedicatedQueue) {
+			batch->graphicsCommandBuffer = new CommandBuffer(device, graphicsCommandPool);
+
+			VkSemaphoreCreateInfo semaphoreInfo{};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			if (vkCreateSemaphore(device->getDevice(), &semaphoreInfo, nullptr, &batch->semaphore) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create upload semaphore.");
+		}
+	}
+	batch->stagingBytes = 0;
+	batch->commandBuffer->beginSingalTimeCommands();
+	if (batch->graphicsCommandBuffer != nullptr)
+		batch->graphicsCommandBuffer->beginSingalTimeCommands();
+	return batch;
+}
+
+std::vector<uint32_t> UploadManager::getSharingFamilies() {
+	if (!dedicatedQueue)
+		return {};
+	return { graphicFamily, transferFamily };
+}
+
+VkCommandBuffer UploadManager::getCommandBuffer() {
+	if (recording == nullptr)
+		recording = acquireBatch();
+	return recording->commandBuffer->getCommandBuffer();
+}
+
+VkCommandBuffer UploadManager::getGraphicsCommandBuffer() {
+	// Work recorded here runs after the copies of the same batch. Exclusive buffers uploaded in the batch
+	// are only acquired at its end, so it may touch images handed over already and shared buffers only.
+	if (recording == nullptr)
+		recording = acquireBatch();
+	if (recording->graphicsCommandBuffer == nullptr)
+		return recording->commandBuffer->getCommandBuffer();
+	return recording->graphicsCommandBuffer->getCommandBuffer();
+}
+
+VkDeviceSize UploadManager::allocateStaging(VkDeviceSize size, Buffer*& stagingBuffer, void*& mapped) {
+	if (size > stagingSize / 2) {
+		stagingBuffer = new Buffer(device, size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		getCommandBuffer();
+		recording->temporaryBuffers.push_back(stagingBuffer);
+		mapped = stagingBuffer->getMappedData();
+		return 0;
+	}
+
+	if (stagingUsed == 0)
+		stagingHead = 0;
+
+	// 16 bytes satisfies buffer copies and the texel block size of every format we upload.
+	VkDeviceSize alignedSize = (size + 15) & ~VkDeviceSize(15);
+	while (true) {
+		VkDeviceSize padding = (stagingHead + alignedSize > stagingSize) ? stagingSize - stagingHead : 0;
+		if (stagingUsed + padding + alignedSize <= stagingSize) {
+			if (padding > 0)
+				stagingHead = 0;
+			VkDeviceSize offset = stagingHead;
+			stagingHead += alignedSize;
+			stagingUsed += padding + alignedSize;
+			getCommandBuffer();
+			recording->stagingBytes += padding + alignedSize;
+			stagingBuffer = stagingRing;
+			mapped = static_cast<char*>(stagingRing->getMappedData()) + offset;
+			return offset;
+		}
+
+		// The ring is full: retire the oldest batch, submitting the one being recorded if it holds the space.
+		if (!inFlight.empty())
+			wait(inFlight.front()->ticket);
+		else if (recording != nullptr && recording->stagingBytes > 0)
+			submit();
+		else
+			throw std::runtime_error("Failed to allocate upload staging memory.");
+	}
+}
+
+void UploadManager::uploadToBuffer(Buffer* dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset) {
+	Buffer* stagingBuffer;
+	void* mapped;
+	VkDeviceSize srcOffset = allocateStaging(size, stagingBuffer, mapped);
+	memcpy(mapped, data, static_cast<size_t>(size));
+	dstBuffer->copyBufferToBuffer(stagingBuffer, getCommandBuffer(), srcOffset, dstOffset, size);
+
+	// Ownership belongs to the whole buffer, so an exclusive one is handed over entirely, once per batch.
+	if (dedicatedQueue && !dstBuffer->isConcurrent()) {
+		for (const auto& transfer : recording->bufferTransfers)
+			if (transfer.buffer == dstBuffer->getBuffer())
+				return;
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = transferFamily;
+		barrier.dstQueueFamilyIndex = graphicFamily;
+		barrier.buffer = dstBuffer->getBuffer();
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		recording->bufferTransfers.push_back(barrier);
+	}
+}
+
+void UploadManager::uploadToImage(VkImage dstImage, const void* data, VkDeviceSize size, uint32_t width, uint32_t height) {
+	Buffer* stagingBuffer;
+	void* mapped;
+	VkDeviceSize srcOffset = allocateStaging(size, stagingBuffer, mapped);
+	memcpy(mapped, data, static_cast<size_t>(size));
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = srcOffset;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { width, height, 1 };
+
+	vkCmdCopyBufferToImage(getCommandBuffer(), stagingBuffer->getBuffer(), dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+}
+
+void UploadManager::transferImageOwnership(VkImage image, VkImageSubresourceRange range, VkImageLayout layout) {
+	if (!dedicatedQueue)
+		return;
+
+	// The layout stays the same, the barrier pair only hands the image over to the graphics family.
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = layout;
+	barrier.newLayout = layout;
+	barrier.srcQueueFamilyIndex = transferFamily;
+	barrier.dstQueueFamilyIndex = graphicFamily;
+	barrier.image = image;
+	barrier.subresourceRange = range;
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(getCommandBuffer(),
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier);
+
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(getGraphicsCommandBuffer(),
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier);
+}
+
+void UploadManager::recordBufferOwnershipTransfers(Batch* batch) {
+	if (batch->bufferTransfers.empty())
+		return;
+
+	for (auto& barrier : batch->bufferTransfers) {
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+	}
+	vkCmdPipelineBarrier(batch->commandBuffer->getCommandBuffer(),
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+		0, nullptr,
+		static_cast<uint32_t>(batch->bufferTransfers.size()), batch->bufferTransfers.data(),
+		0, nullptr);
+
+	for (auto& barrier : batch->bufferTransfers) {
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+			VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+	}
+	vkCmdPipelineBarrier(batch->graphicsCommandBuffer->getCommandBuffer(),
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr,
+		static_cast<uint32_t>(batch->bufferTransfers.size()), batch->bufferTransfers.data(),
+		0, nullptr);
+	batch->bufferTransfers.clear();
+}
+
+void UploadManager::recordEndOfBatchBarrier(VkCommandBuffer commandBuffer) {
+	// Makes every transfer write of the batch visible to whatever consumes it in later submissions.
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+		VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		1, &barrier,
+		0, nullptr,
+		0, nullptr);
+}
+
+UploadTicket UploadManager::submit() {
+	if (recording == nullptr)
+		return lastSubmittedTicket;
+
+	submitBatch(recording);
+	recording->ticket = ++lastSubmittedTicket;
+	inFlight.push_back(recording);
+	recording = nullptr;
+	return lastSubmittedTicket;
+}
+
+void UploadManager::submitBatch(Batch* batch) {
+	if (!dedicatedQueue) {
+		recordEndOfBatchBarrier(batch->commandBuffer->getCommandBuffer());
+		batch->commandBuffer->endCommands();
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch->commandBuffer->getCommandBuffer();
+
+		if (vkQueueSubmit(device->getGraphicQueue(), 1, &submitInfo, batch->fence) != VK_SUCCESS)
+			throw std::runtime_error("Failed to submit upload batch.");
+		return;
+	}
+
+	recordBufferOwnershipTransfers(batch);
+	recordEndOfBatchBarrier(batch->graphicsCommandBuffer->getCommandBuffer());
+	batch->commandBuffer->endCommands();
+	batch->graphicsCommandBuffer->endCommands();
+
+	VkSubmitInfo transferSubmitInfo{};
+	transferSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	transferSubmitInfo.commandBufferCount = 1;
+	transferSubmitInfo.pCommandBuffers = &batch->commandBuffer->getCommandBuffer();
+	transferSubmitInfo.signalSemaphoreCount = 1;
+	transferSubmitInfo.pSignalSemaphores = &batch->semaphore;
+
+	if (vkQueueSubmit(device->getTransferQueue(), 1, &transferSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		throw std::runtime_error("Failed to submit upload batch.");
+
+	// The acquire side signals the fence, so a retired batch has finished on both queues.
+	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	VkSubmitInfo graphicsSubmitInfo{};
+	graphicsSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	graphicsSubmitInfo.waitSemaphoreCount = 1;
+	graphicsSubmitInfo.pWaitSemaphores = &batch->semaphore;
+	graphicsSubmitInfo.pWaitDstStageMask = &waitStage;
+	graphicsSubmitInfo.commandBufferCount = 1;
+	graphicsSubmitInfo.pCommandBuffers = &batch->graphicsCommandBuffer->getCommandBuffer();
+
+	if (vkQueueSubmit(device->getGraphicQueue(), 1, &graphicsSubmitInfo, batch->fence) != VK_SUCCESS)
+		throw std::runtime_error("Failed to submit upload acquire batch.");
+}
+
+void UploadManager::retireBatch(Batch* batch) {
+	for (auto buffer : batch->temporaryBuffers)
+		delete buffer;
+	batch->temporaryBuffers.clear();
+	stagingUsed -= batch->stagingBytes;
+	completedTicket = batch->ticket;
+	freeBatches.push_back(batch);
+}
+
+void UploadManager::retireCompletedBatches() {
+	// Batches complete in submission order on a single queue, so retiring from the front keeps the ring consistent.
+	while (!inFlight.empty() && vkGetFenceStatus(device->getDevice(), inFlight.front()->fence) == VK_SUCCESS) {
+		retireBatch(inFlight.front());
+		inFlight.pop_front();
+	}
+}
+
+bool UploadManager::isComplete(UploadTicket ticket) {
+	retireCompletedBatches();
+	return ticket <= completedTicket;
+}
+
+void UploadManager::wait(UploadTicket ticket) {
+	while (!inFlight.empty() && inFlight.front()->ticket <= ticket) {
+		vkWaitForFences(device->getDevice(), 1, &inFlight.front()->fence, VK_TRUE, UINT64_MAX);
+		retireBatch(inFlight.front());
+		inFlight.pop_front();
+	}
+}
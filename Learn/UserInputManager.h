@@ -1,19 +1,22 @@
 #pragma once
 
-#include <glfw/glfw3.h>
+#include <GLFW/glfw3.h>
+#include <cmath>
 #include <cstdio>
 #include <vector>
 #include "Camera.h"
 #include "ModelMatrix.h"
 
-#ifdef _DEBUG
+#if defined(_DEBUG) && defined(_WIN32)
 #include <conio.h>
 #endif
 
+// The first three objects show one model each and can be moved with the keyboard.
+// Any further objects are copies of the teapot laid out on a grid behind them.
 class UserInputManager {
 public:
-	UserInputManager(Camera* cam) : camera(cam) {
-		initModelMatrices();
+	UserInputManager(Camera* cam, uint32_t instanceCount = 0) : camera(cam) {
+		initModelMatrices(instanceCount);
 	};
 	void cursorManager(GLFWwindow* window, double xOffset, double yOffset);
 	void scrollManager(double yOffset);
@@ -22,9 +25,15 @@ public:
 	void mousceButtonManager(GLFWwindow* window, int button, int action);
 	glm::vec4 getLightPos(int i) { return lightPos[i]; };
 	glm::mat4 getModelMatrix(int i) { return modelMatrices[i]->getModelMatrix(); }
+	uint32_t getModelCount() { return static_cast<uint32_t>(modelMatrices.size()); }
+	/** @brief Index of the model an object shows */
+	int getModelIndex(int i) { return modelIndices[i]; }
+	/** @brief Objects moved since the last call, every object on the first call */
+	std::vector<uint32_t> takeDirtyObjects();
 
 private:
-	void initModelMatrices();
+	void initModelMatrices(uint32_t instanceCount);
+	void markDirty(uint32_t object);
 
 	Camera* camera;
 	double lastX = 0.0, lastY = 0.0;
@@ -32,6 +41,9 @@ private:
 	bool mouseLeftButtonIsClick = false;
 
 	std::vector<ModelMatrix*> modelMatrices;
+	std::vector<int> modelIndices;
+	std::vector<bool> dirty;
+	std::vector<uint32_t> dirtyObjects;
 
 	int currentLight = 0;
 	int currentModel = 0;
@@ -101,6 +113,7 @@ void UserInputManager::keyPressManager(GLFWwindow* window, double deltaTime) {
 		lightPos[currentLight].z -= dLightMovement;
 
 	
+	ModelMatrix previous = *modelMatrices[currentModel];
 	if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
 		modelMatrices[currentModel]->rotation.x += dRotation;
 	if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS)
@@ -131,6 +144,11 @@ void UserInputManager::keyPressManager(GLFWwindow* window, double deltaTime) {
 	if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS)
 		modelMatrices[currentModel]->scale -= dScale;
 
+	const ModelMatrix& current = *modelMatrices[currentModel];
+	if (current.position != previous.position || current.rotation != previous.rotation ||
+		current.scale != previous.scale || current.shear != previous.shear)
+		markDirty(currentModel);
+
 #ifdef _DEBUG
 	std::cout << std::string(100, '\n');
 	printf("CurrentLight: %d, Light1: %.2f %.2f %.2f, , Light2: %.2f %.2f %.2f, , Light3: %.2f %.2f %.2f\nCameraPos: %.2f %.2f %.2f",
@@ -167,8 +185,9 @@ void UserInputManager::mousceButtonManager(GLFWwindow* window, int button, int a
 	}
 }
 
-void UserInputManager::initModelMatrices() {
+void UserInputManager::initModelMatrices(uint32_t instanceCount) {
 	modelMatrices.resize(3);
+	modelIndices = { 0, 1, 2 };
 	float offset = 15.0f;
 	glm::vec3 pos = glm::vec3(0.0f, -offset, 0.0f);
 	glm::vec3 scale;
@@ -182,4 +201,35 @@ void UserInputManager::initModelMatrices() {
 			glm::vec3(-90.0, -90.0, 0.0));
 		pos.y += offset;
 	}
+
+	uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(instanceCount))));
+	float spacing = 8.0f;
+	for (uint32_t i = 0; i < instanceCount; ++i) {
+		glm::vec3 gridPos = glm::vec3(offset + spacing * (i / side), spacing * ((i % side) - 0.5f * side), 0.0f);
+		modelMatrices.push_back(new ModelMatrix(gridPos,
+			glm::vec3(0.2f, 0.2f, 0.2f),
+			glm::vec3(0.0, 0.0, 0.0),
+			glm::vec3(0.0, 0.0, 1.0),
+			glm::vec3(-90.0, -90.0, 0.0)));
+		modelIndices.push_back(1);
+	}
+
+	dirty.assign(modelMatrices.size(), false);
+	for (uint32_t i = 0; i < modelMatrices.size(); ++i)
+		markDirty(i);
+}
+
+void UserInputManager::markDirty(uint32_t object) {
+	if (dirty[object])
+		return;
+	dirty[object] = true;
+	dirtyObjects.push_back(object);
+}
+
+std::vector<uint32_t> UserInputManager::takeDirtyObjects() {
+	std::vector<uint32_t> objects;
+	objects.swap(dirtyObjects);
+	for (uint32_t object : objects)
+		dirty[object] = false;
+	return objects;
 }
\ No newline at end of file
@@ -0,0 +1,346 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "Hash.h"
+
+typedef enum Component {
+	VERTEX_COMPONENT_POSITION = 0x0,
+	VERTEX_COMPONENT_NORMAL = 0x1,
+	VERTEX_COMPONENT_COLOR = 0x2,
+	VERTEX_COMPONENT_UV = 0x3,
+	VERTEX_COMPONENT_TANGENT = 0x4,
+	VERTEX_COMPONENT_BITANGENT = 0x5,
+	VERTEX_COMPONENT_DUMMY_FLOAT = 0x6,
+	VERTEX_COMPONENT_DUMMY_VEC4 = 0x7,
+	// Quantized variants, each feeds the same shader location as its float counterpart
+	VERTEX_COMPONENT_POSITION_HALF = 0x8,	// R16G16B16A16_SFLOAT, w unused
+	VERTEX_COMPONENT_NORMAL_OCT = 0x9,		// R16G16_SNORM octahedral, decoded in the vertex shader
+	VERTEX_COMPONENT_TANGENT_OCT = 0xA,
+	VERTEX_COMPONENT_BITANGENT_OCT = 0xB,
+	VERTEX_COMPONENT_UV_UNORM16 = 0xC,		// R16G16_UNORM, clamped to [0, 1]
+	VERTEX_COMPONENT_COLOR_UNORM8 = 0xD		// R8G8B8A8_UNORM, alpha is 1
+} Component;
+
+/** @brief Which attributes a pipeline fetches */
+enum VertexInputUsage {
+	VERTEX_INPUT_ALL,
+	VERTEX_INPUT_POSITION_ONLY
+};
+
+// Components are grouped into streams, each bound as its own vertex buffer binding.
+// On the CPU a vertex is still the concatenation of its streams, so everything that
+// processes vertices sees a single interleaved array of stride() bytes.
+struct VertexLayout {
+public:
+	std::vector<Component> components;
+	// Stream of every component
+	std::vector<uint32_t> streams;
+
+	VertexLayout(std::vector<Component> components) {
+		this->components = std::move(components);
+		this->streams.assign(this->components.size(), 0);
+	}
+
+	VertexLayout(const std::vector<std::vector<Component>>& streams) {
+		for (size_t stream = 0; stream < streams.size(); ++stream) {
+			for (auto& component : streams[stream]) {
+				this->components.push_back(component);
+				this->streams.push_back(static_cast<uint32_t>(stream));
+			}
+		}
+	}
+
+	static uint32_t componentSize(Component component) {
+		switch (component)
+		{
+		case VERTEX_COMPONENT_UV:
+			return 2 * sizeof(float);
+		case VERTEX_COMPONENT_DUMMY_FLOAT:
+			return sizeof(float);
+		case VERTEX_COMPONENT_DUMMY_VEC4:
+			return 4 * sizeof(float);
+		case VERTEX_COMPONENT_POSITION_HALF:
+			return 4 * sizeof(uint16_t);
+		case VERTEX_COMPONENT_NORMAL_OCT:
+		case VERTEX_COMPONENT_TANGENT_OCT:
+		case VERTEX_COMPONENT_BITANGENT_OCT:
+		case VERTEX_COMPONENT_UV_UNORM16:
+			return 2 * sizeof(uint16_t);
+		case VERTEX_COMPONENT_COLOR_UNORM8:
+			return 4 * sizeof(uint8_t);
+		default:
+			return 3 * sizeof(float);
+		}
+	}
+
+	/** @brief Maps a quantized component to the float component it stores */
+	static Component getSemantic(Component component) {
+		switch (component)
+		{
+		case VERTEX_COMPONENT_POSITION_HALF:
+			return VERTEX_COMPONENT_POSITION;
+		case VERTEX_COMPONENT_NORMAL_OCT:
+			return VERTEX_COMPONENT_NORMAL;
+		case VERTEX_COMPONENT_TANGENT_OCT:
+			return VERTEX_COMPONENT_TANGENT;
+		case VERTEX_COMPONENT_BITANGENT_OCT:
+			return VERTEX_COMPONENT_BITANGENT;
+		case VERTEX_COMPONENT_UV_UNORM16:
+			return VERTEX_COMPONENT_UV;
+		case VERTEX_COMPONENT_COLOR_UNORM8:
+			return VERTEX_COMPONENT_COLOR;
+		default:
+			return component;
+		}
+	}
+
+	static VkFormat getFormat(Component component) {
+		switch (component)
+		{
+		case VERTEX_COMPONENT_UV:
+			return VK_FORMAT_R32G32_SFLOAT;
+		case VERTEX_COMPONENT_POSITION_HALF:
+			return VK_FORMAT_R16G16B16A16_SFLOAT;
+		case VERTEX_COMPONENT_NORMAL_OCT:
+		case VERTEX_COMPONENT_TANGENT_OCT:
+		case VERTEX_COMPONENT_BITANGENT_OCT:
+			return VK_FORMAT_R16G16_SNORM;
+		case VERTEX_COMPONENT_UV_UNORM16:
+			return VK_FORMAT_R16G16_UNORM;
+		case VERTEX_COMPONENT_COLOR_UNORM8:
+			return VK_FORMAT_R8G8B8A8_UNORM;
+		default:
+			return VK_FORMAT_R32G32B32_SFLOAT;
+		}
+	}
+
+	/** @brief Shader input location of a component, or -1 for padding that no shader reads */
+	static int32_t getLocation(Component component) {
+		switch (getSemantic(component))
+		{
+		case VERTEX_COMPONENT_POSITION:
+			return 0;
+		case VERTEX_COMPONENT_NORMAL:
+			return 1;
+		case VERTEX_COMPONENT_UV:
+			return 2;
+		case VERTEX_COMPONENT_COLOR:
+			return 3;
+		case VERTEX_COMPONENT_TANGENT:
+			return 4;
+		case VERTEX_COMPONENT_BITANGENT:
+			return 5;
+		default:
+			return -1;
+		}
+	}
+
+	uint32_t stride() {
+		uint32_t res = 0;
+		for (auto& component : components)
+			res += componentSize(component);
+		return res;
+	}
+
+	uint32_t getStreamCount() {
+		return streams.empty() ? 0 : streams.back() + 1;
+	}
+
+	/** @brief Bytes of one vertex in the given stream */
+	uint32_t stride(uint32_t stream) {
+		uint32_t res = 0;
+		for (size_t i = 0; i < components.size(); ++i)
+			if (streams[i] == stream)
+				res += componentSize(components[i]);
+		return res;
+	}
+
+	/** @brief Byte offset of a stream's components within the interleaved CPU vertex */
+	uint32_t streamOffset(uint32_t stream) {
+		uint32_t res = 0;
+		for (size_t i = 0; i < components.size() && streams[i] < stream; ++i)
+			res += componentSize(components[i]);
+		return res;
+	}
+
+	/** @brief Index of the first component storing the given semantic, or -1 if the layout does not contain it */
+	int32_t find(Component semantic) {
+		for (size_t i = 0; i < components.size(); ++i)
+			if (getSemantic(components[i]) == semantic)
+				return static_cast<int32_t>(i);
+		return -1;
+	}
+
+	/** @brief Byte offset of the first component storing the given semantic, or -1 if the layout does not contain it */
+	int32_t offset(Component semantic) {
+		int32_t index = find(semantic);
+		if (index < 0)
+			return -1;
+		uint32_t res = 0;
+		for (int32_t i = 0; i < index; ++i)
+			res += componentSize(components[i]);
+		return static_cast<int32_t>(res);
+	}
+
+	uint64_t hash() {
+		uint64_t res = FNV_OFFSET_BASIS;
+		// Streams are not hashed, they only change how the vertices are split at upload.
+		for (auto& component : components)
+			res = hashValue(static_cast<uint32_t>(component), res);
+		return res;
+	}
+
+	/** @brief Appends one component of a vertex in its stored format */
+	static void encode(Component component, const glm::vec4& value, std::vector<uint8_t>& out);
+	/** @brief Reads a position, normal, tangent or bitangent back as floats */
+	glm::vec3 decode(const uint8_t* vertex, Component semantic);
+
+	static glm::vec2 encodeOctahedral(glm::vec3 direction);
+	static glm::vec3 decodeOctahedral(glm::vec2 encoded);
+
+	/** @brief Whether a pipeline with the given usage reads anything from the stream */
+	bool isStreamUsed(uint32_t stream, VertexInputUsage usage) {
+		if (usage == VERTEX_INPUT_ALL)
+			return true;
+		for (size_t i = 0; i < components.size(); ++i)
+			if (streams[i] == stream && getLocation(components[i]) == 0)
+				return true;
+		return false;
+	}
+
+	/** @brief One binding per stream, the binding number is the stream index */
+	std::vector<VkVertexInputBindingDescription> getBindingDescriptions(VertexInputUsage usage = VERTEX_INPUT_ALL) {
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+		for (uint32_t stream = 0; stream < getStreamCount(); ++stream) {
+			if (!isStreamUsed(stream, usage))
+				continue;
+			VkVertexInputBindingDescription bindingDescription{};
+			bindingDescription.binding = stream;
+			bindingDescription.stride = stride(stream);
+			bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+			bindingDescriptions.push_back(bindingDescription);
+		}
+		return bindingDescriptions;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> getVertexInputAttributeDescriptions(VertexInputUsage usage = VERTEX_INPUT_ALL) {
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+		std::vector<uint32_t> streamOffsets(getStreamCount(), 0);
+		for (size_t i = 0; i < components.size(); ++i) {
+			Component component = components[i];
+			uint32_t stream = streams[i];
+			int32_t location = getLocation(component);
+			if (location >= 0 && (usage == VERTEX_INPUT_ALL || location == 0)) {
+				VkVertexInputAttributeDescription attributeDescription{};
+				attributeDescription.binding = stream;
+				attributeDescription.location = static_cast<uint32_t>(location);
+				attributeDescription.format = getFormat(component);
+				attributeDescription.offset = streamOffsets[stream];
+				attributeDescriptions.push_back(attributeDescription);
+			}
+			streamOffsets[stream] += componentSize(component);
+		}
+		return attributeDescriptions;
+	}
+};
+
+template <typename T>
+void appendBytes(std::vector<uint8_t>& out, const T& value) {
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void VertexLayout::encode(Component component, const glm::vec4& value, std::vector<uint8_t>& out) {
+	switch (component)
+	{
+	case VERTEX_COMPONENT_UV:
+		appendBytes(out, value.x);
+		appendBytes(out, value.y);
+		break;
+	case VERTEX_COMPONENT_DUMMY_FLOAT:
+		appendBytes(out, 0.0f);
+		break;
+	case VERTEX_COMPONENT_DUMMY_VEC4:
+		for (int i = 0; i < 4; ++i)
+			appendBytes(out, 0.0f);
+		break;
+	case VERTEX_COMPONENT_POSITION_HALF:
+		appendBytes(out, glm::packHalf2x16(glm::vec2(value.x, value.y)));
+		appendBytes(out, glm::packHalf2x16(glm::vec2(value.z, 1.0f)));
+		break;
+	case VERTEX_COMPONENT_NORMAL_OCT:
+	case VERTEX_COMPONENT_TANGENT_OCT:
+	case VERTEX_COMPONENT_BITANGENT_OCT:
+		appendBytes(out, glm::packSnorm2x16(encodeOctahedral(glm::vec3(value.x, value.y, value.z))));
+		break;
+	case VERTEX_COMPONENT_UV_UNORM16:
+		appendBytes(out, glm::packUnorm2x16(glm::vec2(value.x, value.y)));
+		break;
+	case VERTEX_COMPONENT_COLOR_UNORM8:
+		appendBytes(out, glm::packUnorm4x8(glm::vec4(value.x, value.y, value.z, 1.0f)));
+		break;
+	default:
+		appendBytes(out, value.x);
+		appendBytes(out, value.y);
+		appendBytes(out, value.z);
+	}
+}
+
+glm::vec3 VertexLayout::decode(const uint8_t* vertex, Component semantic) {
+	int32_t index = find(semantic);
+	if (index < 0)
+		return glm::vec3(0.0f);
+	const uint8_t* data = vertex + offset(semantic);
+
+	uint32_t packed[2];
+	switch (components[index])
+	{
+	case VERTEX_COMPONENT_POSITION_HALF: {
+		memcpy(packed, data, sizeof(packed));
+		glm::vec2 xy = glm::unpackHalf2x16(packed[0]);
+		return glm::vec3(xy.x, xy.y, glm::unpackHalf2x16(packed[1]).x);
+	}
+	case VERTEX_COMPONENT_NORMAL_OCT:
+	case VERTEX_COMPONENT_TANGENT_OCT:
+	case VERTEX_COMPONENT_BITANGENT_OCT:
+		memcpy(packed, data, sizeof(uint32_t));
+		return decodeOctahedral(glm::unpackSnorm2x16(packed[0]));
+	default: {
+		float values[3];
+		memcpy(values, data, sizeof(values));
+		return glm::vec3(values[0], values[1], values[2]);
+	}
+	}
+}
+
+glm::vec2 VertexLayout::encodeOctahedral(glm::vec3 direction) {
+	// Project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the diagonals.
+	float sum = fabs(direction.x) + fabs(direction.y) + fabs(direction.z);
+	if (sum == 0.0f)
+		return glm::vec2(0.0f);
+	direction /= sum;
+	glm::vec2 encoded(direction.x, direction.y);
+	if (direction.z < 0.0f) {
+		encoded = glm::vec2(
+			(1.0f - fabs(direction.y)) * (direction.x >= 0.0f ? 1.0f : -1.0f),
+			(1.0f - fabs(direction.x)) * (direction.y >= 0.0f ? 1.0f : -1.0f));
+	}
+	return encoded;
+}
+
+glm::vec3 VertexLayout::decodeOctahedral(glm::vec2 encoded) {
+	glm::vec3 direction(encoded.x, encoded.y, 1.0f - fabs(encoded.x) - fabs(encoded.y));
+	if (direction.z < 0.0f) {
+		direction.x = (1.0f - fabs(encoded.y)) * (encoded.x >= 0.0f ? 1.0f : -1.0f);
+		direction.y = (1.0f - fabs(encoded.x)) * (encoded.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return glm::normalize(direction);
+}
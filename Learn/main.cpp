@@ -1,10 +1,45 @@
 #include "Application.h"
 
-int main() {
-	Application app{};
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+void parseArguments(int argc, char** argv, BenchmarkSettings& settings) {
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--benchmark") == 0) {
+			settings.enable = true;
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+				settings.frameCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+			settings.warmupFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+			if (sscanf(argv[++i], "%ux%u", &settings.width, &settings.height) != 2)
+				throw std::runtime_error("Expected --size <width>x<height>.");
+		}
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+			settings.outputPath = argv[++i];
+		else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc)
+			settings.instanceCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (strcmp(argv[i], "--depth-prepass") == 0)
+			settings.depthPrepass = true;
+		else
+			throw std::runtime_error(std::string("Unknown argument: ") + argv[i]);
+	}
+}
+
+int main(int argc, char** argv) {
+	BenchmarkSettings benchmarkSettings{};
+	parseArguments(argc, argv, benchmarkSettings);
+
+	Application app(benchmarkSettings);
 	app.run();
 	
-	std::cout << "\n";
-	system("pause");
+#ifdef _WIN32
+	if (!benchmarkSettings.enable) {
+		std::cout << "\n";
+		system("pause");
+	}
+#endif
 	return 0;
-}
\ No newline at end of file
+}
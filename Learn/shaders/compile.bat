@@ -1,11 +1,13 @@
-@ C:/VulkanSDK/1.2.131.1/Bin32/glslc.exe shader.vert -o vert.spv
-@ C:/VulkanSDK/1.2.131.1/Bin32/glslc.exe shader.frag -o frag.spv
+@ "%VULKAN_SDK%/Bin/glslc.exe" shader.vert -o vert.spv
+@ "%VULKAN_SDK%/Bin/glslc.exe" shader.frag -o frag.spv
 
-C:/VulkanSDK/1.2.131.1/Bin32/glslc.exe phong.vert -o phong.vert.spv
-C:/VulkanSDK/1.2.131.1/Bin32/glslc.exe phong.frag -o phong.frag.spv
+"%VULKAN_SDK%/Bin/glslc.exe" phong.vert -o phong.vert.spv || exit /b 1
+"%VULKAN_SDK%/Bin/glslc.exe" phong.frag -o phong.frag.spv || exit /b 1
 
-C:/VulkanSDK/1.2.131.1/Bin32/glslc.exe gouraud.vert -o gouraud.vert.spv
-C:/VulkanSDK/1.2.131.1/Bin32/glslc.exe gouraud.frag -o gouraud.frag.spv
+"%VULKAN_SDK%/Bin/glslc.exe" gouraud.vert -o gouraud.vert.spv || exit /b 1
+"%VULKAN_SDK%/Bin/glslc.exe" gouraud.frag -o gouraud.frag.spv || exit /b 1
 
-C:/VulkanSDK/1.2.131.1/Bin32/glslc.exe flat.vert -o flat.vert.spv
-C:/VulkanSDK/1.2.131.1/Bin32/glslc.exe flat.frag -o flat.frag.spv
\ No newline at end of file
+"%VULKAN_SDK%/Bin/glslc.exe" flat.vert -o flat.vert.spv || exit /b 1
+"%VULKAN_SDK%/Bin/glslc.exe" flat.frag -o flat.frag.spv || exit /b 1
+
+"%VULKAN_SDK%/Bin/glslc.exe" depth.vert -o depth.vert.spv || exit /b 1
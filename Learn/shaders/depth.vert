@@ -0,0 +1,48 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform UniformBufferObject {
+	mat4 view;
+	mat4 proj;
+	vec4 cameraPos;
+	vec4 lightPos[3];
+} ubo;
+
+// Matches ObjectData in ObjectBuffer.h
+struct ObjectData {
+	mat4 model;
+	mat3 normalMatrix;
+	uint material;
+};
+
+layout (std430, binding = 1) readonly buffer ObjectBuffer {
+	ObjectData objects[];
+} objectBuffer;
+
+// Object of every instance drawn this frame; a draw's instances are consecutive from its first instance
+layout (std430, binding = 2) readonly buffer InstanceBuffer {
+	uint objectIndices[];
+} instances;
+
+// Matches DrawConstants in Pipeline.h
+const uint OBJECT_FROM_INSTANCE = 0xFFFFFFFFu;
+layout (push_constant) uniform DrawConstants {
+	uint objectIndex;
+	uint lod;
+	uint material;
+} draw;
+
+// Only the position stream is bound for this pass
+layout (location = 0) in vec3 inPos;
+
+out gl_PerVertex {
+	vec4 gl_Position;
+};
+invariant gl_Position;
+
+void main() {
+	// Single objects drawn one by one name their object directly.
+	uint objectIndex = draw.objectIndex != OBJECT_FROM_INSTANCE ? draw.objectIndex : instances.objectIndices[gl_InstanceIndex];
+	mat4 model = objectBuffer.objects[objectIndex].model;
+	gl_Position = ubo.proj * ubo.view * model * vec4(inPos, 1.0);
+}
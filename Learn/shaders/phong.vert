@@ -8,12 +8,32 @@ layout (binding = 0) uniform UniformObject {
 	vec4 lightPos[3];
 } ubo;
 
-layout (binding = 1) uniform DynamicUniformObject {
+// Matches ObjectData in ObjectBuffer.h
+struct ObjectData {
 	mat4 model;
-} dynamicUbo;
+	mat3 normalMatrix;
+	uint material;
+};
+
+layout (std430, binding = 1) readonly buffer ObjectBuffer {
+	ObjectData objects[];
+} objectBuffer;
+
+// Object of every instance drawn this frame; a draw's instances are consecutive from its first instance
+layout (std430, binding = 2) readonly buffer InstanceBuffer {
+	uint objectIndices[];
+} instances;
+
+// Matches DrawConstants in Pipeline.h
+const uint OBJECT_FROM_INSTANCE = 0xFFFFFFFFu;
+layout (push_constant) uniform DrawConstants {
+	uint objectIndex;
+	uint lod;
+	uint material;
+} draw;
 
 layout (location = 0) in vec3 inPos;
-layout (location = 1) in vec3 inNormal;
+layout (location = 1) in vec2 inNormal; // octahedral
 layout (location = 2) in vec2 inUV;
 layout (location = 3) in vec3 inColor; 
 
@@ -27,16 +47,30 @@ layout (location = 7) out vec3 outCameraPos;
 out gl_PerVertex {
 	vec4 gl_Position;
 };
+// The depth prepass computes the same position, both must rasterize to identical depths.
+invariant gl_Position;
+
+// Inverse of VertexLayout::encodeOctahedral
+vec3 decodeOctahedral(vec2 encoded) {
+	vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	if (direction.z < 0.0)
+		direction.xy = (1.0 - abs(encoded.yx)) * vec2(encoded.x >= 0.0 ? 1.0 : -1.0, encoded.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(direction);
+}
 
 void main() {
-	outNormal = inNormal;
+	// Single objects drawn one by one name their object directly.
+	uint objectIndex = draw.objectIndex != OBJECT_FROM_INSTANCE ? draw.objectIndex : instances.objectIndices[gl_InstanceIndex];
+	mat4 model = objectBuffer.objects[objectIndex].model;
+	vec3 normal = decodeOctahedral(inNormal);
+	outNormal = normal;
 	outColor = inColor;
 	outUV = inUV;
-	gl_Position = ubo.proj * ubo.view * dynamicUbo.model * vec4(inPos, 1.0);
+	gl_Position = ubo.proj * ubo.view * model * vec4(inPos, 1.0);
 
-	outNormal = mat3(dynamicUbo.model) * inNormal;
+	outNormal = objectBuffer.objects[objectIndex].normalMatrix * normal;
 	
-	vec4 worldPos = dynamicUbo.model * vec4(inPos, 1.0);
+	vec4 worldPos = model * vec4(inPos, 1.0);
 	outWorldPos = worldPos.xyz;
 
 	for (int i = 0; i < 3; i++)